@@ -16,7 +16,64 @@
 /*********************************************************************/
 /*                 Binarization API interface                        */
 /*********************************************************************/
+
+/**
+	Type ia_binarize_local_t
+
+	Defines local adaptive threshold methods, where m and s are the 
+	mean and the standard deviation in the window around the pixel
+*/
+typedef enum
+{
+	IA_BINARIZE_NIBLACK,  /* T = m + k*s, k around -0.2            */
+	IA_BINARIZE_SAUVOLA,  /* T = m*(1 + k*(s/R - 1)), k around 0.3, 
+	                         R is half of the format range         */
+	IA_BINARIZE_BRADLEY   /* T = m*(1 - k), k around 0.15          */
+} ia_binarize_local_t;
+
 void IA_API ia_binarize_level(ia_image_p, ia_uint32_t);
 int IA_API ia_binarize_otsu(ia_image_p);
 
+/* 
+ * Determines the Otsu threshold of gray image. 8-bit images are counted 
+ * into histogram bins on the stack and solved without heap allocation
+ * 1 - success, < 0  - error
+ */
+ia_int32_t IA_API ia_binarize_otsu_threshold(
+						ia_image_p,          /* gray image                   */
+						ia_uint32_t*         /* output threshold             */
+);
+
+/* 
+ * Binarizes by the Otsu threshold straight to new IAT_BOOL image with 
+ * 1 for the pixels at or above the threshold. Images other than 8-bit 
+ * gray are converted to 8-bit gray
+ */
+ia_image_p IA_API ia_binarize_otsu_bool(ia_image_p);
+
+/* 
+ * Binarizes by Otsu thresholds of each tile, bilinearly interpolated 
+ * between the tile centers. Returns new IAT_BOOL image with 1 for the 
+ * pixels at or above their threshold. Images other than 8-bit gray 
+ * are converted to 8-bit gray
+ */
+ia_image_p IA_API ia_binarize_otsu_tiled(
+						ia_image_p,          /* gray or RGB image            */
+						ia_int32_t,          /* tile width                   */
+						ia_int32_t           /* tile height                  */
+);
+
+/* 
+ * Binarizes by local threshold computed in a window x window square 
+ * clipped to the image. Returns new IAT_BOOL image with 1 for the 
+ * pixels above their threshold. RGB images are converted to gray. 
+ * Returns NULL for even window or signed pixel format
+ */
+ia_image_p IA_API ia_binarize_local(
+						ia_image_p,          /* unsigned 8 or 16-bit gray or RGB image */
+						ia_binarize_local_t, /* threshold method             */
+						ia_int32_t,          /* odd window size              */
+						ia_double_t          /* method parameter k           */
+);
+
 #endif
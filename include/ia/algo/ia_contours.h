@@ -25,8 +25,9 @@ typedef enum
 
 typedef struct _ia_contour
 {
-	ia_pos_p*    points;
+	ia_pos_p     points;         /* npoints one after another */
 	ia_int32_t   npoints;
+	ia_int32_t   size;           /* points room */
 	ia_int32_t   nrefs;
 
 	void (*add)            (
@@ -35,6 +36,12 @@ typedef struct _ia_contour
 		ia_int32_t
 	);
 
+	/* makes room for at least the given points count, false if out of memory */
+	ia_bool_t (*reserve)   (
+		struct _ia_contour*,
+		ia_int32_t
+	);
+
 	ia_int32_t (*count_at) (
 		struct _ia_contour*,
 		ia_int32_t, 
@@ -108,7 +115,7 @@ IA_API ia_contours_p ia_contours_find    (ia_image_p, ia_uint32_t);
 	ia_pos_p p;                                          \
 	ia_int32_t _##p;                                     \
 	if (contour)                                         \
-	for (_##p=0, p=contour->points[0]; _##p<contour->npoints; p=contour->points[++_##p])
+	for (_##p=0, p=contour->points; _##p<contour->npoints; p=contour->points + ++_##p)
 
 #define foreach_contour_in_contours(c, cs)               \
 	ia_contour_p c;                                      \
@@ -39,4 +39,42 @@ IA_API void ia_distance_transform_sequential
 	ia_int32_t *,
 	ia_uint32_t *);
 
+/*
+ * Exact Euclidean distance of every nonzero pixel to the nearest zero 
+ * pixel in linear time. The result is IAT_UINT_32 with the squared 
+ * distances or IAT_FLOAT with the distances. All pixels get DT_INF if 
+ * the image has no zero pixel
+ */
+IA_API ia_image_p ia_distance_transform_euclidean
+	(ia_image_p,        /* image of any format */
+	ia_format_t);       /* IAT_UINT_32 or IAT_FLOAT */
+
+/*
+ * Feature transform, the distances of ia_distance_transform_euclidean 
+ * for the pixels in the rectangle with the nearest zero pixel in it as 
+ * index y * width + x in the image. Both results have the rectangle size,
+ * the features are IAT_UINT_32 with IA_MAX_UINT where there is no zero 
+ * pixel. Returns NULL if the rectangle is out of the image or there is 
+ * not enough memory
+ */
+IA_API ia_image_p ia_distance_transform_feature
+	(ia_image_p,        /* image of any format */
+	ia_format_t,        /* IAT_UINT_32 or IAT_FLOAT */
+	const ia_rect_t*,   /* rectangle with inclusive right and bottom clipped to the image, whole image if NULL */
+	ia_image_p*);       /* return the features */
+
+/*
+ * Updates in place a distance map of ia_distance_transform_parallel or 
+ * ia_distance_transform_sequential with the same mask after some pixels 
+ * become sources of distance 0 and some sources stop being such. Only 
+ * the pixels which distances change are visited
+ */
+IA_API void ia_distance_transform_update
+	(ia_image_p,        /* IAT_INT_32 or IAT_UINT_32 distances */
+	ia_image_p,         /* mask */
+	const ia_pos_t*,    /* pixels becoming sources */
+	ia_int32_t,         /* their count */
+	const ia_pos_t*,    /* sources removed */
+	ia_int32_t);        /* their count */
+
 #endif /* __IA_DISTANCE_TRANSFORM_H */
@@ -0,0 +1,106 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_integral_image.h                                */
+/* Description:   Integral image (summed-area table)                 */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef __IA_INTEGRAL_IMAGE_H
+#define __IA_INTEGRAL_IMAGE_H
+
+#include <ia/ia_image.h>
+
+/*********************************************************************/
+/*                 Integral image API interface                      */
+/*********************************************************************/
+
+/**
+	Type ia_integral_t
+
+	Defines the integral image accumulator types. The integer sums 
+	wrap around, so a rectangle sum is still exact as long as the 
+	sum itself fits in the accumulator
+*/
+typedef enum
+{
+	IA_INTEGRAL_32,     /* ia_uint32_t sums */
+	IA_INTEGRAL_64,     /* ia_uint64_t sums */
+	IA_INTEGRAL_DOUBLE  /* ia_double_t sums */
+} ia_integral_t;
+
+/**
+	Type ia_integral_image_t
+
+	Defines tables of (height+1) rows by stride = width+1 elements 
+	where element (x, y) holds the sum of all image pixels left and 
+	above of it, so the first row and column are 0
+*/
+typedef struct _ia_integral_image_t
+{
+	/** source image horizontal pixels count */
+	ia_uint16_t                         width;
+
+	/** source image vertical pixels count */
+	ia_uint16_t                         height;
+
+	/** accumulator type */
+	ia_integral_t                       type;
+
+	/** true if the source pixels are signed and integer sums are to be read as signed */
+	ia_bool_t                           is_signed;
+
+	/** elements per table row */
+	ia_uint32_t                         stride;
+
+	/** pixel sums table */
+	void*                               sum;
+
+	/** squared pixel sums table or NULL if not requested */
+	void*                               sqsum;
+
+	/** sum of the pixels inside a rectangle clipped to the image */
+	ia_double_t (*rect_sum)             (
+		struct _ia_integral_image_t*, /** self */
+		const ia_rect_t*              /** rectangle with inclusive right and bottom */
+	);
+
+	/** sum of the squared pixels inside a rectangle clipped to the image */
+	ia_double_t (*rect_sqsum)           (
+		struct _ia_integral_image_t*, /** self */
+		const ia_rect_t*              /** rectangle with inclusive right and bottom */
+	);
+
+	/** mean and variance of the pixels inside a rectangle clipped to the image */
+	void (*rect_mean_variance)          (
+		struct _ia_integral_image_t*, /** self */
+		const ia_rect_t*,             /** rectangle with inclusive right and bottom */
+		ia_double_t*,                 /** return mean */
+		ia_double_t*                  /** return variance, ignored if NULL */
+	);
+
+	/** destroy integral image object */
+	void (*destroy)                     (
+		struct _ia_integral_image_t* /** self */
+	);
+
+} ia_integral_image_t, *ia_integral_image_p;
+
+/**
+	Sum of a typed table over the pixels l..r, t..b without clipping, 
+	e.g. IA_INTEGRAL_RECT((ia_uint32_t*)ii->sum, ii->stride, l, t, r, b)
+*/
+#define IA_INTEGRAL_RECT(table, stride, l, t, r, b) \
+	((table)[((b)+1)*(stride) + (r)+1] - (table)[((b)+1)*(stride) + (l)] \
+	- (table)[(t)*(stride) + (r)+1] + (table)[(t)*(stride) + (l)])
+
+/** creates integral image of a gray image */
+IA_API ia_integral_image_p ia_integral_image_new(
+	ia_image_p,    /** gray image                              */
+	ia_integral_t, /** accumulator type                        */
+	ia_bool_t      /** IA_TRUE to compute the squared sums too */
+);
+
+#endif /* __IA_INTEGRAL_IMAGE_H */
@@ -17,9 +17,155 @@
 /*                     Morphology API interface                      */
 /*********************************************************************/
 
+/**
+	Type ia_structure_shape_t
+
+	Structuring element shapes with a faster path than the general one. 
+	Diamonds and octagons are decomposed only where that is cheaper
+*/
+typedef enum
+{
+	IA_STRUCTURE_GENERAL,
+	/** all pixels set, the horizontal and vertical lines included */
+	IA_STRUCTURE_RECT,
+	/** odd square with the pixels (i, i) set only */
+	IA_STRUCTURE_DIAGONAL,
+	/** odd square with the pixels (n-1-i, i) set only */
+	IA_STRUCTURE_ANTIDIAGONAL,
+	/** |dx| + |dy| <= r, applied as two diagonals and one or two 3x3 crosses */
+	IA_STRUCTURE_DIAMOND,
+	/** odd rectangle dilated by a diamond, applied as the rectangle and the diamond */
+	IA_STRUCTURE_OCTAGON
+} ia_structure_shape_t;
+
+/**
+	Type ia_structure_t
+
+	Structuring element compiled from an image with the set pixels 
+	nonzero and the center at (width/2, height/2)
+*/
+typedef struct _ia_structure_t
+{
+	/** element width */
+	ia_int32_t                          width;
+
+	/** element height */
+	ia_int32_t                          height;
+
+	/** detected shape */
+	ia_structure_shape_t                shape;
+
+	/** number of set pixels */
+	ia_int32_t                          count;
+
+	/** x offsets of the set pixels from the center, row by row */
+	ia_int32_t*                         dx;
+
+	/** y offsets of the set pixels from the center */
+	ia_int32_t*                         dy;
+
+	/** dy*stride + dx of the set pixels for the last stride given to offsets */
+	ia_int32_t*                         offset;
+
+	/** the stride of offset */
+	ia_int32_t                          stride;
+
+	/** number of distinct nonempty rows */
+	ia_int32_t                          patterns;
+
+	/** pattern of each row, -1 for the empty rows */
+	ia_int32_t*                         pattern;
+
+	/** runs of set pixels in each row */
+	ia_int32_t*                         runs;
+
+	/** run start columns, width entries per row */
+	ia_int32_t*                         starts;
+
+	/** run lengths, width entries per row */
+	ia_int32_t*                         lengths;
+
+	/** number of elements whose successive dilations make this one, 0 if not decomposed */
+	ia_int32_t                          factors;
+
+	/** the decomposition elements */
+	struct _ia_structure_t**            factor;
+
+	/** computes the offsets for an image with stride pixels per row, not thread safe */
+	const ia_int32_t* (*offsets)        (
+		struct _ia_structure_t*, /** self */
+		ia_int32_t               /** stride */
+	);
+
+	/** destroy structuring element */
+	void (*destroy)                     (
+		struct _ia_structure_t*  /** self */
+	);
+
+} ia_structure_t, *ia_structure_p;
+
+/** compiles structuring element from image */
+IA_API ia_structure_p ia_structure_new(ia_image_p);
+
+/*
+ * The structuring element is an image or a compiled element, the image 
+ * is compiled on every call. The dilation of 8 and 16-bit gray images 
+ * is the maximum of the pixels at the center minus the element offsets 
+ * and the erosion the minimum of those at the center plus the offsets, 
+ * the pixels out of the image do not count. A full rectangle, a 
+ * horizontal or vertical line or an odd sized diagonal takes constant 
+ * time per pixel, diamonds and octagons are applied as their 
+ * decomposition. IAT_BOOL images are processed packed, 64 pixels per 
+ * word. Other formats copy the nonzero colors as before. IAT_BOOL and 
+ * the other formats erode keeping the pixels whose center minus the 
+ * element offsets are all nonzero, the pixels out of the image are 
+ * background
+ */
 IA_API ia_image_p ia_morphology_dilation(ia_image_p, ia_image_p);
 IA_API ia_image_p ia_morphology_erosion (ia_image_p, ia_image_p);
 IA_API ia_image_p ia_morphology_opening (ia_image_p, ia_image_p);
 IA_API ia_image_p ia_morphology_closing (ia_image_p, ia_image_p);
 
+IA_API ia_image_p ia_morphology_dilation_se(ia_image_p, ia_structure_p);
+IA_API ia_image_p ia_morphology_erosion_se (ia_image_p, ia_structure_p);
+IA_API ia_image_p ia_morphology_opening_se (ia_image_p, ia_structure_p);
+IA_API ia_image_p ia_morphology_closing_se (ia_image_p, ia_structure_p);
+
+/*
+ * n erosions followed by n dilations and the other way around. Gray 8 
+ * and 16-bit images stream row bands through all of them without 
+ * intermediate images
+ */
+IA_API ia_image_p ia_morphology_opening_n(ia_image_p, ia_structure_p, ia_int32_t);
+IA_API ia_image_p ia_morphology_closing_n(ia_image_p, ia_structure_p, ia_int32_t);
+
+/* image minus its opening, the bright details smaller than the element */
+IA_API ia_image_p ia_morphology_top_hat  (ia_image_p, ia_image_p);
+IA_API ia_image_p ia_morphology_top_hat_se  (ia_image_p, ia_structure_p);
+
+/* closing minus the image, the dark details smaller than the element */
+IA_API ia_image_p ia_morphology_black_hat(ia_image_p, ia_image_p);
+IA_API ia_image_p ia_morphology_black_hat_se(ia_image_p, ia_structure_p);
+
+/* dilation minus erosion */
+IA_API ia_image_p ia_morphology_gradient (ia_image_p, ia_image_p);
+IA_API ia_image_p ia_morphology_gradient_se (ia_image_p, ia_structure_p);
+
+/*
+ * Returns IAT_BOOL image with 1 where the foreground (nonzero) covers 
+ * the hit element and the background covers the miss element, which 
+ * can be NULL. The pixels out of the image are background
+ */
+IA_API ia_image_p ia_morphology_hit_or_miss(
+	ia_image_p,    /* image */
+	ia_image_p,    /* hit structuring element */
+	ia_image_p     /* miss structuring element or NULL */
+);
+
+IA_API ia_image_p ia_morphology_hit_or_miss_se(
+	ia_image_p,    /* image */
+	ia_structure_p,/* hit structuring element */
+	ia_structure_p /* miss structuring element or NULL */
+);
+
 #endif /* __IA_MORPHOLOGY_H */
@@ -18,6 +18,23 @@
 /*                 Otsu API interface                                */
 /*********************************************************************/
 
+/* 
+ * Determines count thresholds in a histogram by maximizing the between 
+ * class variance in O(count*L*log(L)) for L histogram levels. The class 
+ * k covers the levels (treshold[k-1], treshold[k]]
+ * 1 - success, -1 - empty histogram, -2 - no memory, 
+ * -3 - count is 0 or not less than the histogram length
+ */
+ia_int32_t IA_API ia_otsu_n(
+						ia_signal_p,  /* input signal                     */
+						ia_uint32_t,  /* number of thresholds             */
+						ia_uint32_t*, /* output count tresholds           */
+						ia_uint32_t*, /* output mean                      */
+						ia_uint32_t*, /* output count+1 class means       */
+						ia_double_t*, /* output count+1 class areas       */
+						ia_double_t*  /* output max criterion             */
+);
+
 /* 
  * Determines a threshold in a histogram
  * 1 - success, < 0  - error
@@ -33,6 +50,18 @@ ia_int32_t IA_API ia_otsu(
 						ia_double_t*  /* output max criterion */
 );
 
+/* 
+ * Determines the ia_otsu threshold in a histogram given as array of 
+ * bins, without allocating memory
+ * 1 - success, < 0  - error
+ */
+ia_int32_t IA_API ia_otsu_bins(
+						const ia_uint32_t*, /* histogram bins        */
+						ia_uint32_t,        /* number of bins        */
+						ia_uint32_t*,       /* output treshold       */
+						ia_double_t*        /* output max criterion  */
+);
+
 /* 
  * Determines 2 thresholds in a histogram
  * 1 - success, < 0  - error
@@ -0,0 +1,74 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_reconstruction.h                                */
+/* Description:   Morphological reconstruction                       */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef __IA_RECONSTRUCTION_H
+#define __IA_RECONSTRUCTION_H
+
+#include <ia/ia_image.h>
+
+/*********************************************************************/
+/*               Morphological reconstruction API                    */
+/*********************************************************************/
+
+/**
+	Type ia_connectivity_t
+
+	Defines the neighbors of a pixel
+*/
+typedef enum
+{
+	IA_CONNECTIVITY_4 = 4,  /* left, right, up and down */
+	IA_CONNECTIVITY_8 = 8   /* the diagonals too */
+} ia_connectivity_t;
+
+/*
+ * The images are 8-bit gray or IAT_BOOL and the result has the same
+ * format. The pixels out of the image are not neighbors of any pixel
+ */
+
+/*
+ * Reconstruction by dilation, the marker dilated under the mask until
+ * stable. The marker is taken as min(marker, mask)
+ */
+IA_API ia_image_p ia_reconstruction_dilation(
+	ia_image_p,         /* marker */
+	ia_image_p,         /* mask of the same size and format */
+	ia_connectivity_t   /* connectivity */
+);
+
+/*
+ * Reconstruction by erosion, the marker eroded over the mask until
+ * stable. The marker is taken as max(marker, mask)
+ */
+IA_API ia_image_p ia_reconstruction_erosion(
+	ia_image_p,         /* marker */
+	ia_image_p,         /* mask of the same size and format */
+	ia_connectivity_t   /* connectivity */
+);
+
+/* fills the dark regions not reachable from the image border */
+IA_API ia_image_p ia_reconstruction_fill_holes(ia_image_p, ia_connectivity_t);
+
+/* removes the bright regions connected to the image border */
+IA_API ia_image_p ia_reconstruction_clear_border(ia_image_p, ia_connectivity_t);
+
+/* suppresses the regional maxima not higher than h over their surroundings */
+IA_API ia_image_p ia_reconstruction_h_maxima(ia_image_p, ia_uint32_t, ia_connectivity_t);
+
+/* suppresses the regional minima not deeper than h */
+IA_API ia_image_p ia_reconstruction_h_minima(ia_image_p, ia_uint32_t, ia_connectivity_t);
+
+/* returns IAT_BOOL image with 1 at the connected plateaus with lower neighbors only */
+IA_API ia_image_p ia_reconstruction_regional_maxima(ia_image_p, ia_connectivity_t);
+
+/* returns IAT_BOOL image with 1 at the connected plateaus with higher neighbors only */
+IA_API ia_image_p ia_reconstruction_regional_minima(ia_image_p, ia_connectivity_t);
+
+#endif /* __IA_RECONSTRUCTION_H */
@@ -56,11 +56,18 @@ typedef enum
 typedef unsigned char  ia_uint8_t;
 typedef unsigned short ia_uint16_t;
 typedef ia_uint8_t     ia_uint24_t[3];
-typedef unsigned long  ia_uint32_t;
+typedef unsigned int   ia_uint32_t;
 typedef signed char    ia_int8_t;
 typedef signed short   ia_int16_t;
 typedef ia_int8_t      ia_int24_t[3];
 typedef signed int     ia_int32_t;
+#ifdef _MSC_VER
+typedef unsigned __int64 ia_uint64_t;
+typedef signed __int64   ia_int64_t;
+#else
+typedef unsigned long long ia_uint64_t;
+typedef signed long long   ia_int64_t;
+#endif
 typedef float          ia_float_t;
 typedef double         ia_double_t;
 typedef ia_uint8_t     ia_bool_t;
@@ -33,6 +33,20 @@ typedef enum
 	IA_COLOR_ELEMENT_SATURATION
 } ia_color_element_t;
 
+/**
+	Type ia_hsv_range_t
+
+	Defines a box in the HSV color space. Hue is in [0, 359], 
+	saturation and value are in [0, 255]. When huemin > huemax 
+	the hue range wraps around 0, e.g. 340..20 selects reds
+*/
+typedef struct
+{
+	ia_uint32_t huemin, huemax;
+	ia_uint32_t satmin, satmax;
+	ia_uint32_t valmin, valmax;
+} ia_hsv_range_t, *ia_hsv_range_p;
+
 /**
 	Type ia_image_t
 
@@ -79,6 +93,21 @@ typedef struct _ia_image_t
 		ia_uint16_t          /** y coordinate */
 	);
 
+	/** set a pixel value, rounded and saturated for integer pixel formats */
+	void (*set_pixel_double)            (
+		struct _ia_image_t*, /** self */
+		ia_uint16_t,         /** x coordinate */
+		ia_uint16_t,         /** y coordinate */
+		ia_double_t          /** pixel value */
+	);
+
+	/** get a pixel value, sign extended for signed pixel formats */
+	ia_double_t (*get_pixel_double)     (
+		struct _ia_image_t*, /** self */
+		ia_uint16_t,         /** x coordinate */
+		ia_uint16_t          /** y coordinate */
+	);
+
 	/** fill the image with specified color */
 	void (*fill)                        (
 		struct _ia_image_t*, /** self */
@@ -102,6 +131,14 @@ typedef struct _ia_image_t
 		ia_format_t          /** pixel format */
 	);
 	
+	/** convert gray image to any pixel format as round(color * scale + offset) saturated to the format range */
+	struct _ia_image_t* (*convert)      (
+		struct _ia_image_t*, /** self */
+		ia_format_t,         /** pixel format */
+		ia_double_t,         /** scale */
+		ia_double_t          /** offset */
+	);
+	
 	/** normalize pixel colors to occupy better the specified range */
 	void (*normalize_colors)            (
 		struct _ia_image_t*, /** self */
@@ -116,6 +153,13 @@ typedef struct _ia_image_t
 		struct _ia_image_t* /** self */
 	);
 
+	/** inverse gray colors inside known range, the format range gives full range inversion */
+	void (*inverse_range)               (
+		struct _ia_image_t*, /** self */
+		ia_int32_t,          /** min color or 0 if unknown */
+		ia_uint32_t          /** max color or 0 if unknown */
+	);
+
 	/** mask */
 	void (*mask)                        (
 		struct _ia_image_t*, /** self */
@@ -137,6 +181,13 @@ typedef struct _ia_image_t
 		ia_uint32_t, ia_uint32_t  /* val min/max */
 	);
 
+	/** create IAT_BOOL mask of the pixels inside any of the given HSV ranges */
+	struct _ia_image_t* (*extract_hsv_mask) (
+		struct _ia_image_t*,   /** self */
+		const ia_hsv_range_t*, /** HSV ranges */
+		ia_int32_t             /** number of ranges */
+	);
+
 	/** determines min and max colors in the image */
 	void (*get_min_max)                 (
 		struct _ia_image_t*, /** self */
@@ -211,13 +262,19 @@ typedef struct _ia_image_t
 
 } ia_image_t, *ia_image_p;
 
+/** number of bytes occupied by one image row */
+#define IA_IMAGE_STRIDE(img) ((((ia_uint32_t)(img)->width) * ia_format_size((img)->format) + 7) >> 3)
+
+/** pointer to the first byte of the image row y */
+#define IA_IMAGE_ROW(img, y) (((ia_uint8_t*)(img)->pixels.data) + (ia_uint32_t)(y) * IA_IMAGE_STRIDE(img))
+
 
 /** load an image from file                */
 IA_API ia_image_p ia_image_load   (
 	const ia_string_t /** file name        */
 );
 
-/** creates new image */
+/** creates new image with all pixels set to 0 */
 IA_API ia_image_p ia_image_new    (
 	ia_uint16_t, /** image width            */
 	ia_uint16_t, /** image height           */
@@ -0,0 +1,144 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_pixels.h                                        */
+/* Description:   Pixel row conversion module interface              */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef __IA_PIXELS_H
+#define __IA_PIXELS_H
+
+#include <ia/ia.h>
+
+/*********************************************************************/
+/*                      Pixel rows API interface                     */
+/*********************************************************************/
+
+/** Unpacks 24-bit RGB pixels into 32-bit IA_RGB colors */
+IA_API void ia_pixels_rgb24_to_rgb32(
+	const ia_uint8_t*,            /* source 24-bit pixels */
+	ia_uint32_t*,                 /* destination colors */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Packs 32-bit IA_RGB colors into 24-bit RGB pixels */
+IA_API void ia_pixels_rgb32_to_rgb24(
+	const ia_uint32_t*,           /* source colors */
+	ia_uint8_t*,                  /* destination 24-bit pixels */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Converts 24-bit RGB pixels to 8-bit gray as IA_GRAY does */
+IA_API void ia_pixels_rgb24_to_gray(
+	const ia_uint8_t*,            /* source 24-bit pixels */
+	ia_uint8_t*,                  /* destination gray pixels */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Converts 32-bit IA_RGB colors to 8-bit gray as IA_GRAY does */
+IA_API void ia_pixels_rgb32_to_gray(
+	const ia_uint32_t*,           /* source colors */
+	ia_uint8_t*,                  /* destination gray pixels */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Splits 24-bit RGB pixels into 8-bit red, green and blue planes */
+IA_API void ia_pixels_rgb24_to_planes(
+	const ia_uint8_t*,            /* source 24-bit pixels */
+	ia_uint8_t*,                  /* destination red plane */
+	ia_uint8_t*,                  /* destination green plane */
+	ia_uint8_t*,                  /* destination blue plane */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Splits 32-bit IA_RGB colors into 8-bit red, green and blue planes */
+IA_API void ia_pixels_rgb32_to_planes(
+	const ia_uint32_t*,           /* source colors */
+	ia_uint8_t*,                  /* destination red plane */
+	ia_uint8_t*,                  /* destination green plane */
+	ia_uint8_t*,                  /* destination blue plane */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Interleaves 8-bit red, green and blue planes into 24-bit RGB pixels */
+IA_API void ia_pixels_planes_to_rgb24(
+	const ia_uint8_t*,            /* source red plane */
+	const ia_uint8_t*,            /* source green plane */
+	const ia_uint8_t*,            /* source blue plane */
+	ia_uint8_t*,                  /* destination 24-bit pixels */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Interleaves 8-bit red, green and blue planes into 32-bit IA_RGB colors */
+IA_API void ia_pixels_planes_to_rgb32(
+	const ia_uint8_t*,            /* source red plane */
+	const ia_uint8_t*,            /* source green plane */
+	const ia_uint8_t*,            /* source blue plane */
+	ia_uint32_t*,                 /* destination colors */
+	ia_uint32_t                   /* pixels count */
+);
+
+/**
+	Converts pixels between any two formats as 
+	dst = round(src * scale + offset), where integer destinations 
+	are rounded half up and saturated to the format range. 
+	Signed formats are sign extended, IAT_BOOL pixels are packed 
+	bits starting from bit 0 of the first byte
+*/
+IA_API void ia_pixels_convert(
+	const void*,                  /* source pixels */
+	ia_format_t,                  /* source format */
+	void*,                        /* destination pixels */
+	ia_format_t,                  /* destination format */
+	ia_uint32_t,                  /* pixels count */
+	ia_double_t,                  /* scale */
+	ia_double_t                   /* offset */
+);
+
+/**
+	Creates table of 256 or 65536 entries with the same width as the 
+	8 or 16-bit format, mapping every color exactly as 
+	floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min)).
+	The table is released with free()
+*/
+IA_API void* ia_pixels_normalize_lut(
+	ia_format_t,                  /* 8 or 16-bit pixel format */
+	ia_int32_t,                   /* from min color */
+	ia_uint32_t,                  /* from max color */
+	ia_int32_t,                   /* to min color */
+	ia_uint32_t                   /* to max color */
+);
+
+/** Maps 8-bit pixels through a table of 256 entries in place */
+IA_API void ia_pixels_lut_8(
+	ia_uint8_t*,                  /* pixels */
+	const ia_uint8_t*,            /* table */
+	ia_uint32_t                   /* pixels count */
+);
+
+/** Maps 16-bit pixels through a table of 65536 entries in place */
+IA_API void ia_pixels_lut_16(
+	ia_uint16_t*,                 /* pixels */
+	const ia_uint16_t*,           /* table */
+	ia_uint32_t                   /* pixels count */
+);
+
+/**
+	Maps 32-bit colors from [min, max] onto [new_min, new_max] in place 
+	with exactly rounded down integer arithmetic, colors outside 
+	[min, max] are saturated. min must differ from max
+*/
+IA_API void ia_pixels_normalize_32(
+	ia_uint32_t*,                 /* pixels */
+	ia_uint32_t,                  /* pixels count */
+	ia_bool_t,                    /* true for signed colors */
+	ia_int32_t,                   /* from min color */
+	ia_uint32_t,                  /* from max color */
+	ia_int32_t,                   /* to min color */
+	ia_uint32_t                   /* to max color */
+);
+
+#endif /* __IA_PIXELS_H */
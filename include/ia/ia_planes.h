@@ -0,0 +1,105 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_planes.h                                        */
+/* Description:   Planar RGB image module                            */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef __IA_PLANES_H
+#define __IA_PLANES_H
+
+#include <ia/ia.h>
+#include <ia/ia_image.h>
+
+/*********************************************************************/
+/*                           Planes API                              */
+/*********************************************************************/
+
+/**
+	Type ia_planes_t
+
+	Defines RGB image stored as three consecutive 8-bit planes, 
+	red, green and blue, each of width*height bytes. The planes 
+	are exposed as IAT_UINT_8 gray images sharing the planes data, 
+	so all gray image operations apply to a single color channel
+*/
+typedef struct _ia_planes_t
+{
+	/** planes horizontal pixels count */
+	ia_uint16_t                         width;
+
+	/** planes vertical pixels count */
+	ia_uint16_t                         height;
+
+	/** raw planes data, red plane followed by green and blue */
+	ia_data_t                           pixels;
+
+	/** true if planes data is passed by the user and should not be freed */
+	ia_bool_t                           is_user_data;
+
+	/** red plane view */
+	ia_image_p                          red;
+
+	/** green plane view */
+	ia_image_p                          green;
+
+	/** blue plane view */
+	ia_image_p                          blue;
+
+	/** get plane view by color element */
+	ia_image_p (*plane)                 (
+		struct _ia_planes_t*, /** self */
+		ia_color_element_t    /** red, green or blue */
+	);
+
+	/** load pixels from RGB image with the same size */
+	void (*from_image)                  (
+		struct _ia_planes_t*, /** self */
+		ia_image_p            /** 24 or 32-bit RGB image */
+	);
+
+	/** create new RGB image from the planes */
+	ia_image_p (*to_image)              (
+		struct _ia_planes_t*, /** self */
+		ia_format_t           /** IAT_UINT_24 or IAT_UINT_32 */
+	);
+
+	/** inverse all planes */
+	void (*inverse)                     (
+		struct _ia_planes_t* /** self */
+	);
+
+	/** allocate memory and copy these planes */
+	struct _ia_planes_t* (*copy)        (
+		struct _ia_planes_t* /** self */
+	);
+
+	/** destroy planes object */
+	void (*destroy)                     (
+		struct _ia_planes_t* /** self */
+	);
+
+} ia_planes_t, *ia_planes_p;
+
+/** creates new planes with all pixels set to 0 */
+IA_API ia_planes_p ia_planes_new    (
+	ia_uint16_t, /** planes width           */
+	ia_uint16_t  /** planes height          */
+);
+
+/** creates new planes from user data of 3*width*height bytes */
+IA_API ia_planes_p ia_planes_from_data    (
+	ia_uint16_t, /** planes width           */
+	ia_uint16_t, /** planes height          */
+	void*        /** planes data            */
+);
+
+/** creates new planes from 24 or 32-bit RGB image */
+IA_API ia_planes_p ia_planes_from_image    (
+	ia_image_p   /** RGB image              */
+);
+
+#endif /* __IA_PLANES_H */
@@ -7,7 +7,16 @@
 /* Description:   Binarization module                                */
 /*                                                                   */
 /*********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <ia/algo/ia_binarize.h>
+#include <ia/algo/ia_otsu.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void ia_binarize_level(ia_image_p img, ia_uint32_t level)
 {
@@ -40,3 +49,527 @@ void ia_binarize_otsu_(ia_image_p img)
         ia_binarize_level(img, min + ((max-min)>>1));
 }
 
+
+int ia_binarize_otsu(ia_image_p img)
+{
+	return img->binarize_otsu(img, NULL);
+}
+
+ia_int32_t ia_binarize_otsu_threshold(ia_image_p img, ia_uint32_t* threshold)
+{
+	ia_uint32_t bins[256];
+	ia_int32_t  y;
+
+	if (!img->is_gray || img->format != IAT_UINT_8)
+	{
+		ia_signal_p histo = img->histogram(img, IA_COLOR_ELEMENT_VALUE);
+		ia_int32_t result = ia_otsu(histo, threshold, 0, 0, 0, 0, 0, 0);
+		histo->destroy(histo);
+		return result;
+	}
+
+	memset(bins, 0, sizeof(bins));
+#pragma omp parallel
+	{
+		/* 4 sets of bins, so runs of equal pixels do not wait on each other */
+		ia_uint32_t local[4][256];
+		ia_int32_t  x, c;
+		memset(local, 0, sizeof(local));
+#pragma omp for schedule(static)
+		for (y=0; y<img->height; y++)
+		{
+			const ia_uint8_t* row = IA_IMAGE_ROW(img, y);
+			for (x=0; x + 3 < img->width; x+=4)
+			{
+				local[0][row[x]]++;
+				local[1][row[x + 1]]++;
+				local[2][row[x + 2]]++;
+				local[3][row[x + 3]]++;
+			}
+			for (; x<img->width; x++)
+			{
+				local[0][row[x]]++;
+			}
+		}
+#pragma omp critical
+		{
+			for (c=0; c<256; c++)
+			{
+				bins[c] += local[0][c] + local[1][c] + local[2][c] + local[3][c];
+			}
+		}
+	}
+	return ia_otsu_bins(bins, 256, threshold, NULL);
+}
+
+/* Packs the 8-bit pixels at or above the threshold into bits starting from bit 0 */
+static void ia_binarize_row_bool(const ia_uint8_t* row, ia_uint8_t* bits, ia_int32_t width, ia_uint32_t threshold)
+{
+	ia_int32_t x = 0;
+	ia_uint8_t byte = 0;
+#ifdef __SSE2__
+	const __m128i t = _mm_set1_epi8((char)threshold);
+	for (; x + 16 <= width; x+=16)
+	{
+		/* c >= t exactly when max(c, t) == c, the sign bits are the output bits */
+		__m128i    c    = _mm_loadu_si128((const __m128i*)(row + x));
+		ia_int32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(c, t), c));
+		bits[x >> 3]       = (ia_uint8_t)mask;
+		bits[(x >> 3) + 1] = (ia_uint8_t)(mask >> 8);
+	}
+#endif
+	for (; x<width; x++)
+	{
+		byte |= (ia_uint8_t)((row[x] >= threshold) << (x & 7));
+		if ((x & 7) == 7 || x == width - 1)
+		{
+			bits[x >> 3] = byte;
+			byte = 0;
+		}
+	}
+}
+
+ia_image_p ia_binarize_otsu_bool(ia_image_p img)
+{
+	ia_image_p  src = img, out = NULL;
+	ia_uint32_t threshold;
+	ia_int32_t  y;
+
+	if (!img->is_gray || img->format != IAT_UINT_8)
+	{
+		src = img->convert_gray(img, IAT_UINT_8);
+	}
+
+	if (ia_binarize_otsu_threshold(src, &threshold) > 0)
+	{
+		out = ia_image_new(img->width, img->height, IAT_BOOL, IA_IMAGE_GRAY);
+	}
+
+	if (out)
+	{
+#pragma omp parallel for schedule(static)
+		for (y=0; y<img->height; y++)
+		{
+			ia_binarize_row_bool(IA_IMAGE_ROW(src, y), IA_IMAGE_ROW(out, y), img->width, threshold);
+		}
+	}
+
+	if (src != img)
+	{
+		src->destroy(src);
+	}
+	return out;
+}
+
+/*
+ * Finds the tile centers around pos along an axis split in tiles of the 
+ * given size, as the first tile index and the weight of the next one. 
+ * Outside of the first and the last centers both tiles are the same
+ */
+static void ia_binarize_tile_weight(ia_int32_t pos, ia_int32_t tile, ia_int32_t length, ia_int32_t count,
+									ia_int32_t* index, ia_float_t* weight)
+{
+	ia_int32_t  i = pos / tile;
+	ia_float_t  c = i * tile + (MIN(tile, length - i * tile) - 1) * 0.5f;
+	ia_float_t  next;
+	if (pos < c)
+	{
+		i--;
+	}
+	if (i < 0 || i >= count - 1)
+	{
+		*index  = MAX(0, MIN(i, count - 1));
+		*weight = 0.0f;
+		return ;
+	}
+	c    = i * tile + (tile - 1) * 0.5f;
+	next = (i + 1) * tile + (MIN(tile, length - (i + 1) * tile) - 1) * 0.5f;
+	*index  = i;
+	*weight = (pos - c) / (next - c);
+}
+
+ia_image_p ia_binarize_otsu_tiled(ia_image_p img, ia_int32_t tile_width, ia_int32_t tile_height)
+{
+	ia_image_p   src, out;
+	ia_int32_t   w = img->width, h = img->height;
+	ia_int32_t   tx, ty, tiles, i;
+	ia_uint32_t* bins;
+	ia_float_t*  thresholds;
+	ia_int32_t*  col_index;
+	ia_float_t*  col_weight;
+	ia_uint32_t  global[256];
+	ia_uint32_t  global_threshold = 0;
+	ia_bool_t    failed = IA_FALSE;
+
+	if (img->is_gray && ia_format_size(img->format) == 8)
+	{
+		src = img;
+	}
+	else
+	{
+		src = img->convert_gray(img, IAT_UINT_8);
+	}
+
+	tile_width  = MAX(1, MIN(tile_width, w));
+	tile_height = MAX(1, MIN(tile_height, h));
+	tx    = (w + tile_width - 1) / tile_width;
+	ty    = (h + tile_height - 1) / tile_height;
+	tiles = tx * ty;
+
+	out        = ia_image_new(w, h, IAT_BOOL, IA_IMAGE_GRAY);
+	bins       = (ia_uint32_t*)calloc(tiles * 256, sizeof(ia_uint32_t));
+	thresholds = (ia_float_t*)malloc(tiles * sizeof(ia_float_t));
+	col_index  = (ia_int32_t*)malloc(w * sizeof(ia_int32_t));
+	col_weight = (ia_float_t*)malloc(w * sizeof(ia_float_t));
+	if (!out || !bins || !thresholds || !col_index || !col_weight)
+	{
+		ASSERT(0), "ia_binarize_otsu_tiled -> Out of memory!\n");
+		if (out) out->destroy(out);
+		free(bins);
+		free(thresholds);
+		free(col_index);
+		free(col_weight);
+		if (src != img) src->destroy(src);
+		return NULL;
+	}
+
+	/* the histograms of all tiles in one pass, a tile row per thread */
+#pragma omp parallel for schedule(dynamic)
+	for (i=0; i<ty; i++)
+	{
+		ia_int32_t x, y, j;
+		for (y=i * tile_height; y<MIN((i + 1) * tile_height, h); y++)
+		{
+			const ia_uint8_t* row = IA_IMAGE_ROW(src, y);
+			for (j=0; j<tx; j++)
+			{
+				ia_uint32_t* hist = bins + (i * tx + j) * 256;
+				for (x=j * tile_width; x<MIN((j + 1) * tile_width, w); x++)
+				{
+					hist[row[x]]++;
+				}
+			}
+		}
+	}
+
+	/* tiles of a single color have no threshold of their own */
+	memset(global, 0, sizeof(global));
+	for (i=0; i<tiles * 256; i++)
+	{
+		global[i & 255] += bins[i];
+	}
+	ia_otsu_bins(global, 256, &global_threshold, NULL);
+
+#pragma omp parallel for schedule(static)
+	for (i=0; i<tiles; i++)
+	{
+		const ia_uint32_t* hist = bins + i * 256;
+		ia_uint32_t t = global_threshold;
+		ia_int32_t  c, colors = 0;
+		for (c=0; c<256 && colors < 2; c++)
+		{
+			colors += hist[c] > 0;
+		}
+		if (colors > 1)
+		{
+			ia_otsu_bins(hist, 256, &t, NULL);
+		}
+		thresholds[i] = (ia_float_t)t;
+	}
+
+	for (i=0; i<w; i++)
+	{
+		ia_binarize_tile_weight(i, tile_width, w, tx, col_index + i, col_weight + i);
+	}
+
+	/* threshold every pixel at the bilinear blend of the 4 nearest tiles */
+#pragma omp parallel
+	{
+		ia_float_t* row_thresholds = (ia_float_t*)malloc((tx + 1) * sizeof(ia_float_t));
+		ia_int32_t  y;
+#pragma omp for schedule(static) reduction(|:failed)
+		for (y=0; y<h; y++)
+		{
+			const ia_uint8_t* row  = IA_IMAGE_ROW(src, y);
+			ia_uint8_t*       bits = IA_IMAGE_ROW(out, y);
+			const ia_float_t* t0;
+			const ia_float_t* t1;
+			ia_uint8_t byte = 0;
+			ia_int32_t x, j, ti;
+			ia_float_t fy;
+
+			if (!row_thresholds)
+			{
+				failed = IA_TRUE;
+				continue;
+			}
+			ia_binarize_tile_weight(y, tile_height, h, ty, &ti, &fy);
+			t0 = thresholds + ti * tx;
+			t1 = thresholds + MIN(ti + 1, ty - 1) * tx;
+			for (j=0; j<tx; j++)
+			{
+				row_thresholds[j] = t0[j] + (t1[j] - t0[j]) * fy;
+			}
+			row_thresholds[tx] = row_thresholds[tx - 1];
+
+			for (x=0; x<w; x++)
+			{
+				const ia_float_t* t = row_thresholds + col_index[x];
+				ia_float_t threshold = t[0] + (t[1] - t[0]) * col_weight[x];
+				byte |= (ia_uint8_t)((row[x] >= threshold) << (x & 7));
+				if ((x & 7) == 7 || x == w - 1)
+				{
+					bits[x >> 3] = byte;
+					byte = 0;
+				}
+			}
+		}
+		free(row_thresholds);
+	}
+
+	free(bins);
+	free(thresholds);
+	free(col_index);
+	free(col_weight);
+	if (src != img)
+	{
+		src->destroy(src);
+	}
+	if (failed)
+	{
+		/* not enough memory for the row thresholds */
+		out->destroy(out);
+		return NULL;
+	}
+	return out;
+}
+
+/*
+ * The local sums are taken from a rolling integral image. Every row band 
+ * keeps the sums of each column over the window rows, adding the row 
+ * entering the window and removing the one leaving it, and the prefix 
+ * sums of these column sums give any window sum in the row with 2 
+ * lookups. The bands are independent and run in parallel.
+ */
+typedef struct
+{
+	ia_image_p          src;
+	ia_image_p          out;
+	ia_binarize_local_t method;
+	ia_int32_t          radius;
+	ia_double_t         k;
+	ia_double_t         range;     /* Sauvola R */
+	ia_double_t*        inv_cols;  /* 1 / window columns at each x */
+} ia_binarize_local_param_t;
+
+/*
+ * Adds the row y_in to the column sums and removes the row y_out, either 
+ * can be -1, then rebuilds the prefix sums of the columns in the same pass
+ */
+static void ia_binarize_local_columns(ia_image_p src, ia_int32_t y_in, ia_int32_t y_out, const ia_uint8_t* zeros,
+									  ia_uint32_t* colsum, ia_uint64_t* colsq, ia_uint64_t* sum, ia_uint64_t* sq)
+{
+	ia_int32_t x;
+	const ia_uint8_t* in  = y_in  >= 0 ? IA_IMAGE_ROW(src, y_in)  : zeros;
+	const ia_uint8_t* out = y_out >= 0 ? IA_IMAGE_ROW(src, y_out) : zeros;
+	sum[0] = sq[0] = 0;
+	if (ia_format_size(src->format) == 8)
+	{
+		for (x=0; x<src->width; x++)
+		{
+			colsum[x] += in[x] - out[x];
+			colsq[x]  += (ia_int32_t)(in[x] * in[x]) - (ia_int32_t)(out[x] * out[x]);
+			sum[x + 1] = sum[x] + colsum[x];
+			sq[x + 1]  = sq[x] + colsq[x];
+		}
+	}
+	else
+	{
+		const ia_uint16_t* in16  = (const ia_uint16_t*)in;
+		const ia_uint16_t* out16 = (const ia_uint16_t*)out;
+		for (x=0; x<src->width; x++)
+		{
+			colsum[x] += in16[x] - out16[x];
+			colsq[x]  += (ia_uint64_t)((ia_uint32_t)in16[x] * in16[x]) - (ia_uint32_t)out16[x] * out16[x];
+			sum[x + 1] = sum[x] + colsum[x];
+			sq[x + 1]  = sq[x] + colsq[x];
+		}
+	}
+}
+
+static void ia_binarize_local_band(const ia_binarize_local_param_t* param, ia_int32_t y0, ia_int32_t y1, 
+								   const ia_uint8_t* zeros, ia_uint32_t* colsum, ia_uint64_t* colsq, ia_uint64_t* sum, ia_uint64_t* sq)
+{
+	ia_image_p src = param->src;
+	ia_int32_t w = src->width, h = src->height, r = param->radius;
+	ia_int32_t x, y;
+	ia_double_t one_k   = 1.0 - param->k;
+	ia_double_t k_range = param->k / param->range;
+
+	memset(colsum, 0, w * sizeof(ia_uint32_t));
+	memset(colsq, 0, w * sizeof(ia_uint64_t));
+	for (y=MAX(y0 - r, 0); y<=MIN(y0 + r, h - 1); y++)
+	{
+		ia_binarize_local_columns(src, y, -1, zeros, colsum, colsq, sum, sq);
+	}
+
+	for (y=y0; y<y1; y++)
+	{
+		ia_int32_t  rows     = MIN(y + r, h - 1) - MAX(y - r, 0) + 1;
+		ia_double_t inv_rows = 1.0 / rows;
+		ia_uint8_t* bits     = IA_IMAGE_ROW(param->out, y);
+		ia_uint8_t  byte     = 0;
+		const ia_uint8_t*  row8  = NULL;
+		const ia_uint16_t* row16 = NULL;
+
+		if (ia_format_size(src->format) == 8)
+			row8 = IA_IMAGE_ROW(src, y);
+		else
+			row16 = (const ia_uint16_t*)IA_IMAGE_ROW(src, y);
+
+		if (y > y0 && (y + r < h || y - r - 1 >= 0))
+		{
+			ia_binarize_local_columns(src, y + r < h ? y + r : -1, y - r - 1, zeros, colsum, colsq, sum, sq);
+		}
+
+		for (x=0; x<w; x++)
+		{
+			ia_int32_t  x1 = x - r < 0 ? 0 : x - r;
+			ia_int32_t  x2 = x + r >= w ? w - 1 : x + r;
+			ia_double_t inv_n = param->inv_cols[x] * inv_rows;
+			/* window sums are far below 2^63, signed converts faster */
+			ia_double_t m  = (ia_double_t)(ia_int64_t)(sum[x2 + 1] - sum[x1]) * inv_n;
+			ia_double_t c  = row8 ? row8[x] : row16[x];
+			ia_bool_t   above;
+
+			if (param->method == IA_BINARIZE_BRADLEY)
+			{
+				above = c > m * one_k;
+			}
+			else
+			{
+				/* 
+				 * both thresholds are a + b*s with s = sqrt(var), so
+				 * c > a + b*s is decided on the squares without sqrt
+				 */
+				ia_double_t var = (ia_double_t)(ia_int64_t)(sq[x2 + 1] - sq[x1]) * inv_n - m * m;
+				ia_double_t a, b;
+				if (param->method == IA_BINARIZE_NIBLACK)
+				{
+					a = c - m;
+					b = param->k;
+				}
+				else
+				{
+					a = c - m * one_k;
+					b = m * k_range;
+				}
+				if (var < 0.0)
+				{
+					var = 0.0;
+				}
+				/* no short circuit, the outcome is data dependent */
+				if (b >= 0.0)
+					above = (ia_bool_t)((a > 0.0) & (a * a > b * b * var));
+				else
+					above = (ia_bool_t)((a > 0.0) | (a * a < b * b * var));
+			}
+
+			byte |= (ia_uint8_t)(above << (x & 7));
+			if ((x & 7) == 7 || x == w - 1)
+			{
+				bits[x >> 3] = byte;
+				byte = 0;
+			}
+		}
+	}
+}
+
+ia_image_p ia_binarize_local(ia_image_p img, ia_binarize_local_t method, ia_int32_t window, ia_double_t k)
+{
+	ia_binarize_local_param_t param;
+	ia_int32_t i, band, bands;
+	ia_bool_t  failed = IA_FALSE;
+
+	if (window < 1 || !(window & 1))
+	{
+		ASSERT(0), "ia_binarize_local -> The window size %d is not odd!\n", window);
+		return NULL;
+	}
+
+	if (!img->is_gray)
+	{
+		param.src = img->convert_gray(img, IAT_UINT_8);
+	}
+	else if (!ia_format_signed(img->format) && (ia_format_size(img->format) == 8 || ia_format_size(img->format) == 16))
+	{
+		/* the bands read the pixels as unsigned */
+		param.src = img;
+	}
+	else
+	{
+		ASSERT(0), "ia_binarize_local -> Not supported format %s!\n", ia_format_name(img->format));
+		return NULL;
+	}
+
+	param.out    = ia_image_new(img->width, img->height, IAT_BOOL, IA_IMAGE_GRAY);
+	param.method = method;
+	param.radius = window / 2;
+	param.k      = k;
+	param.range  = ia_format_size(param.src->format) == 8 ? 128.0 : 32768.0;
+
+	/* a band pays one window of rows to start, so it is a few windows high */
+	band  = MAX(4 * window, 64);
+	bands = (img->height + band - 1) / band;
+
+	param.inv_cols = (ia_double_t*)malloc(img->width * sizeof(ia_double_t));
+	if (!param.out || !param.inv_cols)
+	{
+		ASSERT(0), "ia_binarize_local -> Out of memory!\n");
+		if (param.out) param.out->destroy(param.out);
+		free(param.inv_cols);
+		if (param.src != img) param.src->destroy(param.src);
+		return NULL;
+	}
+	for (i=0; i<img->width; i++)
+	{
+		param.inv_cols[i] = 1.0 / (MIN(i + param.radius, img->width - 1) - MAX(i - param.radius, 0) + 1);
+	}
+
+#pragma omp parallel
+	{
+		ia_uint32_t* colsum = (ia_uint32_t*)malloc(img->width * sizeof(ia_uint32_t));
+		ia_uint64_t* colsq  = (ia_uint64_t*)malloc(img->width * sizeof(ia_uint64_t));
+		ia_uint64_t* sum    = (ia_uint64_t*)malloc((img->width + 1) * sizeof(ia_uint64_t));
+		ia_uint64_t* sq     = (ia_uint64_t*)malloc((img->width + 1) * sizeof(ia_uint64_t));
+		ia_uint8_t*  zeros  = (ia_uint8_t*)calloc(img->width, sizeof(ia_uint16_t));
+#pragma omp for schedule(dynamic) reduction(|:failed)
+		for (i=0; i<bands; i++)
+		{
+			if (!colsum || !colsq || !sum || !sq || !zeros)
+			{
+				failed = IA_TRUE;
+				continue;
+			}
+			ia_binarize_local_band(&param, i * band, MIN((i + 1) * band, img->height), zeros, colsum, colsq, sum, sq);
+		}
+		free(colsum);
+		free(colsq);
+		free(sum);
+		free(sq);
+		free(zeros);
+	}
+
+	free(param.inv_cols);
+	if (param.src != img)
+	{
+		param.src->destroy(param.src);
+	}
+	if (failed)
+	{
+		/* not enough memory for the band buffers */
+		param.out->destroy(param.out);
+		return NULL;
+	}
+	return param.out;
+}
@@ -17,6 +17,7 @@
 ia_contours_p ia_contours_find(ia_image_p, ia_uint32_t);
 
 static void          ia_contour_add        (ia_contour_p, ia_int32_t, ia_int32_t);
+static ia_bool_t     ia_contour_reserve    (ia_contour_p, ia_int32_t);
 static ia_int32_t    ia_contour_count_at   (ia_contour_p, ia_int32_t, ia_int32_t);
 static contour_point_location_t ia_contour_point_in   (ia_contour_p, ia_int32_t, ia_int32_t);
 static ia_bool_t     ia_contour_in_contour (ia_contour_p, ia_contour_p);
@@ -41,9 +42,11 @@ ia_contour_p ia_contour_new( void )
 
 	contour->points      = 0;
 	contour->npoints     = 0;
+	contour->size        = 0;
 	contour->nrefs       = 1;
 
 	contour->add         = ia_contour_add;
+	contour->reserve     = ia_contour_reserve;
 	contour->count_at    = ia_contour_count_at;
 	contour->point_in    = ia_contour_point_in;
 	contour->in_contour  = ia_contour_in_contour;	
@@ -56,12 +59,26 @@ ia_contour_p ia_contour_new( void )
 	return contour;
 }
 
+static ia_bool_t ia_contour_reserve(ia_contour_p self, ia_int32_t count)
+{
+	ia_pos_p points;
+	if (count <= self->size)
+		return IA_TRUE;
+	points = (ia_pos_p)realloc(self->points, sizeof(ia_pos_t)*count);
+	if (!points)
+		return IA_FALSE;
+	self->points = points;
+	self->size   = count;
+	return IA_TRUE;
+}
+
 static void ia_contour_add(ia_contour_p self, ia_int32_t x, ia_int32_t y)
 {
-	self->points                   = (ia_pos_p*)realloc(self->points, sizeof(ia_pos_t)*(self->npoints+1));
-	self->points[self->npoints]    = (ia_pos_p)malloc(sizeof(ia_pos_t));
-	self->points[self->npoints]->x = x;
-	self->points[self->npoints]->y = y;
+	/* the room doubles, so adding n points copies less than 2n */
+	if (self->npoints == self->size && !ia_contour_reserve(self, self->size ? 2*self->size : 64))
+		return;
+	self->points[self->npoints].x = x;
+	self->points[self->npoints].y = y;
 	self->npoints++;
 }
 
@@ -72,13 +89,10 @@ static void ia_contour_add_ref (ia_contour_p self)
 
 static void ia_contour_destroy (ia_contour_p self)
 {
-	ia_int32_t i;
 	assert(self->nrefs>0);
 	self->nrefs--;
 	if (self->nrefs == 0)
 	{
-		for (i=0; i<self->npoints; i++)
-			free(self->points[i]);
 		free(self->points);
 		free(self);
 	}
@@ -111,7 +125,7 @@ static ia_int32_t ia_contour_count_at(ia_contour_p self, ia_int32_t x, ia_int32_
 	ia_int32_t j=0, count=0;
 	while (j<self->npoints)
 	{
-		if (self->points[j]->y == y && self->points[j]->x == x) count++;
+		if (self->points[j].y == y && self->points[j].x == x) count++;
 		j++;
 	}
 	return count;
@@ -138,7 +152,7 @@ static contour_point_location_t ia_contour_point_in(ia_contour_p self, ia_int32_
  */
 static ia_bool_t ia_contour_in_contour(ia_contour_p self, ia_contour_p contour)
 {
-	contour_point_location_t location=self->point_in(self, contour->points[0]->x, contour->points[0]->y);
+	contour_point_location_t location=self->point_in(self, contour->points[0].x, contour->points[0].y);
 	return location == CONTOUR_POINT_INSIDE || location == CONTOUR_POINT_OVER;
 }
 
@@ -150,7 +164,7 @@ static void ia_contour_draw(ia_contour_p self, ia_image_p img, ia_uint32_t color
 	ia_int32_t i;
 	for (i=0; i<self->npoints; i++)
 	{
-		img->set_pixel(img, self->points[i]->x, self->points[i]->y, color);
+		img->set_pixel(img, self->points[i].x, self->points[i].y, color);
 	}
 }
 
@@ -258,9 +272,9 @@ static struct _ia_contour* ia_find_encapsulating_contour(ia_contour_p self)
 	current_point.y=IA_MAX_INT;
 	for (i=0; i<self->npoints; i++)
 	{
-		if (self->points[i]->y < current_point.y || (self->points[i]->y == current_point.y && self->points[i]->x < current_point.x))
+		if (self->points[i].y < current_point.y || (self->points[i].y == current_point.y && self->points[i].x < current_point.x))
 		{
-			current_point=*self->points[i];
+			current_point=self->points[i];
 		}
 	}
 	prev_point.x=current_point.x-1;
@@ -278,27 +292,27 @@ static struct _ia_contour* ia_find_encapsulating_contour(ia_contour_p self)
 		len=0;
 		for (i=0; i<self->npoints; i++)
 		{
-			if (self->points[i]->x != current_point.x || self->points[i]->y != current_point.y)
+			if (self->points[i].x != current_point.x || self->points[i].y != current_point.y)
 			{
-				//a2=atan2(current_point.y-self->points[i]->y, current_point.x-self->points[i]->x);
-				a2=vector_angle(&prev_point, &current_point, self->points[i]);
+				//a2=atan2(current_point.y-self->points[i].y, current_point.x-self->points[i].x);
+				a2=vector_angle(&prev_point, &current_point, &self->points[i]);
 				tlen=sqrt( 
-						(self->points[i]->x - current_point.x)*(self->points[i]->x - current_point.x) + 
-						(self->points[i]->y - current_point.y)*(self->points[i]->y - current_point.y)
+						(self->points[i].x - current_point.x)*(self->points[i].x - current_point.x) + 
+						(self->points[i].y - current_point.y)*(self->points[i].y - current_point.y)
 				);
 
 				if (a1-a2<ad || ( (a1-a2==ad) && tlen > len) )
 				{
 					ad=a1-a2;
 					len=tlen;
-					next_point=*self->points[i];
+					next_point=self->points[i];
 				}
 			}
 		}
 		prev_point=current_point;
 		current_point=next_point;
 		a1=a2;
-	} while (current_point.x != contour->points[0]->x || current_point.y != contour->points[0]->y);
+	} while (current_point.x != contour->points[0].x || current_point.y != contour->points[0].y);
 
 	return contour;
 }
@@ -478,6 +492,7 @@ ia_contours_p ia_contours_find(ia_image_p img, ia_uint32_t bkcolor)
   		contour->fill(contour, history, 1, 0);
 		contours->add(contours, contour);
 	}
+	history->destroy(history);
 	return contours;
 }
 
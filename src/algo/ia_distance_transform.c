@@ -9,8 +9,13 @@
 /*********************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <ia/algo/ia_distance_transform.h>
 
+/* columns per band of the column pass */
+#define IA_DISTANCE_BAND 256
+
 ia_image_p ia_distance_transform_mask(ia_int32_t mask_size, ia_int32_t a, ia_int32_t b, ia_int32_t c, ia_int32_t d, ia_int32_t e)
 {
 	ia_int32_t center;
@@ -67,7 +72,8 @@ ia_image_p ia_distance_transform_mask(ia_int32_t mask_size, ia_int32_t a, ia_int
 	return mask;
 }
 
-void ia_distance_transform_parallel(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
+/* iterates whole mask sweeps until nothing changes through get_pixel and set_pixel */
+static void ia_distance_transform_parallel_pixels(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
 {
 	int mask_center=(mask->height+1)/2-1;
 	ia_bool_t change=1;
@@ -112,7 +118,8 @@ void ia_distance_transform_parallel(ia_image_p in, ia_image_p mask, ia_int32_t *
 	}
 }
 
-void ia_distance_transform_sequential(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
+/* the passes through get_pixel and set_pixel for the formats not holding 32-bit distances */
+static void ia_distance_transform_sequential_pixels(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
 {
 	ia_int32_t mask_center=(mask->height+1)/2-1;
 	ia_int32_t i,j,n,m,neighbour_x,neighbour_y;
@@ -183,3 +190,911 @@ void ia_distance_transform_sequential(ia_image_p in, ia_image_p mask, ia_int32_t
 		if (value>*max) *max=value;
 	}
 }
+
+/*
+ * Collects the finite mask weights of one pass with their offsets in a 
+ * buffer of the given stride, forward for the neighbors before the center
+ * in the raster order and backward for the ones after it. The center is
+ * in both. The center and the neighbor set just before in the same row 
+ * come first when present. Returns the count
+ */
+static ia_int32_t ia_distance_transform_weights(ia_image_p mask, ia_int32_t stride, ia_bool_t is_forward, ia_int32_t* offset, ia_uint32_t* weight)
+{
+	ia_int32_t center = (mask->height + 1) / 2 - 1;
+	ia_int32_t step = is_forward ? 1 : -1;
+	ia_int32_t m, n, k, count = 0;
+	ia_int32_t o;
+	ia_uint32_t w;
+
+	for (n=0; n<mask->height; n++)
+	for (m=0; m<mask->width; m++)
+	{
+		if (is_forward ? (n > center || (n == center && m > center)) : (n < center || (n == center && m < center)))
+			continue;
+		w = mask->get_pixel(mask, m, n);
+		if (w == DT_INF)
+			continue;
+		o = (n - center) * stride + m - center;
+		/* the order only matters for ia_distance_transform_chained */
+		k = count++;
+		for (; k > 0 && (o == 0 || (o == -step && offset[k - 1] != 0)); k--)
+		{
+			offset[k] = offset[k - 1];
+			weight[k] = weight[k - 1];
+		}
+		offset[k] = o;
+		weight[k] = w;
+	}
+	return count;
+}
+
+/*
+ * The 3x3, 5x5 and 7x7 masks of ia_distance_transform_mask with the 
+ * center and the neighbor before it in the row as first weights, the rest
+ * from rows already done
+ */
+static ia_bool_t ia_distance_transform_chained(ia_int32_t count, ia_int32_t step, const ia_int32_t* offset, ia_int32_t radius)
+{
+	ia_int32_t k;
+	if ((count != 5 && count != 9 && count != 17) || offset[0] != 0 || offset[1] != -step)
+		return IA_FALSE;
+	/* the offsets in the same row are not more than the radius */
+	for (k=2; k<count; k++)
+		if (ABS(offset[k]) <= radius)
+			return IA_FALSE;
+	return IA_TRUE;
+}
+
+#define IA_DISTANCE_TRANSFORM_LOAD(k) o##k = offset[k]; w##k = weight[k]
+#define IA_DISTANCE_TRANSFORM_TERM(k) u = MIN(u, p[o##k] + w##k)
+
+/*
+ * One pass over n pixels of a row starting from p, step is 1 forward and
+ * -1 backward. The weights stay in registers, the neighbors from the rows
+ * done do not wait for the pixel before and the pixel before is not read
+ * back from the memory
+ */
+static void ia_distance_transform_row_3(ia_uint32_t* p, ia_int32_t n, ia_int32_t step, const ia_int32_t* offset, const ia_uint32_t* weight)
+{
+	ia_int32_t  x, o2, o3, o4;
+	ia_uint32_t u, v = p[-step], w0 = weight[0], w1 = weight[1], w2, w3, w4;
+	IA_DISTANCE_TRANSFORM_LOAD(2); IA_DISTANCE_TRANSFORM_LOAD(3); IA_DISTANCE_TRANSFORM_LOAD(4);
+	for (x=0; x<n; x++, p+=step)
+	{
+		u = MIN(DT_INF, p[0] + w0);
+		IA_DISTANCE_TRANSFORM_TERM(2); IA_DISTANCE_TRANSFORM_TERM(3); IA_DISTANCE_TRANSFORM_TERM(4);
+		v += w1;
+		v = MIN(u, v);
+		*p = v;
+	}
+}
+
+static void ia_distance_transform_row_5(ia_uint32_t* p, ia_int32_t n, ia_int32_t step, const ia_int32_t* offset, const ia_uint32_t* weight)
+{
+	ia_int32_t  x, o2, o3, o4, o5, o6, o7, o8;
+	ia_uint32_t u, v = p[-step], w0 = weight[0], w1 = weight[1], w2, w3, w4, w5, w6, w7, w8;
+	IA_DISTANCE_TRANSFORM_LOAD(2); IA_DISTANCE_TRANSFORM_LOAD(3); IA_DISTANCE_TRANSFORM_LOAD(4);
+	IA_DISTANCE_TRANSFORM_LOAD(5); IA_DISTANCE_TRANSFORM_LOAD(6); IA_DISTANCE_TRANSFORM_LOAD(7);
+	IA_DISTANCE_TRANSFORM_LOAD(8);
+	for (x=0; x<n; x++, p+=step)
+	{
+		u = MIN(DT_INF, p[0] + w0);
+		IA_DISTANCE_TRANSFORM_TERM(2); IA_DISTANCE_TRANSFORM_TERM(3); IA_DISTANCE_TRANSFORM_TERM(4);
+		IA_DISTANCE_TRANSFORM_TERM(5); IA_DISTANCE_TRANSFORM_TERM(6); IA_DISTANCE_TRANSFORM_TERM(7);
+		IA_DISTANCE_TRANSFORM_TERM(8);
+		v += w1;
+		v = MIN(u, v);
+		*p = v;
+	}
+}
+
+static void ia_distance_transform_row_7(ia_uint32_t* p, ia_int32_t n, ia_int32_t step, const ia_int32_t* offset, const ia_uint32_t* weight)
+{
+	ia_int32_t  x, o2, o3, o4, o5, o6, o7, o8, o9, o10, o11, o12, o13, o14, o15, o16;
+	ia_uint32_t u, v = p[-step], w0 = weight[0], w1 = weight[1], w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15, w16;
+	IA_DISTANCE_TRANSFORM_LOAD(2);  IA_DISTANCE_TRANSFORM_LOAD(3);  IA_DISTANCE_TRANSFORM_LOAD(4);
+	IA_DISTANCE_TRANSFORM_LOAD(5);  IA_DISTANCE_TRANSFORM_LOAD(6);  IA_DISTANCE_TRANSFORM_LOAD(7);
+	IA_DISTANCE_TRANSFORM_LOAD(8);  IA_DISTANCE_TRANSFORM_LOAD(9);  IA_DISTANCE_TRANSFORM_LOAD(10);
+	IA_DISTANCE_TRANSFORM_LOAD(11); IA_DISTANCE_TRANSFORM_LOAD(12); IA_DISTANCE_TRANSFORM_LOAD(13);
+	IA_DISTANCE_TRANSFORM_LOAD(14); IA_DISTANCE_TRANSFORM_LOAD(15); IA_DISTANCE_TRANSFORM_LOAD(16);
+	for (x=0; x<n; x++, p+=step)
+	{
+		u = MIN(DT_INF, p[0] + w0);
+		IA_DISTANCE_TRANSFORM_TERM(2);  IA_DISTANCE_TRANSFORM_TERM(3);  IA_DISTANCE_TRANSFORM_TERM(4);
+		IA_DISTANCE_TRANSFORM_TERM(5);  IA_DISTANCE_TRANSFORM_TERM(6);  IA_DISTANCE_TRANSFORM_TERM(7);
+		IA_DISTANCE_TRANSFORM_TERM(8);  IA_DISTANCE_TRANSFORM_TERM(9);  IA_DISTANCE_TRANSFORM_TERM(10);
+		IA_DISTANCE_TRANSFORM_TERM(11); IA_DISTANCE_TRANSFORM_TERM(12); IA_DISTANCE_TRANSFORM_TERM(13);
+		IA_DISTANCE_TRANSFORM_TERM(14); IA_DISTANCE_TRANSFORM_TERM(15); IA_DISTANCE_TRANSFORM_TERM(16);
+		v += w1;
+		v = MIN(u, v);
+		*p = v;
+	}
+}
+
+/* any other mask, each neighbor read from the buffer */
+static void ia_distance_transform_row(ia_uint32_t* p, ia_int32_t n, ia_int32_t step, const ia_int32_t* offset, const ia_uint32_t* weight, ia_int32_t count)
+{
+	ia_int32_t  x, k;
+	ia_uint32_t v;
+	for (x=0; x<n; x++, p+=step)
+	{
+		v = DT_INF;
+		for (k=0; k<count; k++)
+			v = MIN(v, p[offset[k]] + weight[k]);
+		*p = v;
+	}
+}
+
+/*
+ * The distances of a 32-bit image in a buffer framed with DT_INF by the 
+ * mask radius, so the pixels out of the image need no checks, with the 
+ * mask weights of the forward [0] and backward [1] passes
+ */
+typedef struct
+{
+	ia_int32_t   width;
+	ia_int32_t   height;
+	ia_int32_t   stride;
+	ia_int32_t   radius;
+	ia_uint32_t* buffer;
+	ia_uint32_t* origin;         /* pixel (0, 0) */
+	ia_int32_t   count[2];
+	ia_int32_t*  offset[2];
+	ia_uint32_t* weight[2];
+	ia_bool_t    is_chained[2];
+} ia_distance_transform_chamfer_t;
+
+static void ia_distance_transform_chamfer_free(ia_distance_transform_chamfer_t* self)
+{
+	free(self->buffer);
+	free(self->offset[0]);
+	free(self->offset[1]);
+	free(self->weight[0]);
+	free(self->weight[1]);
+}
+
+static ia_bool_t ia_distance_transform_chamfer_load(ia_distance_transform_chamfer_t* self, ia_image_p in, ia_image_p mask)
+{
+	ia_int32_t i, y, size = mask->width * mask->height;
+
+	self->width  = in->width;
+	self->height = in->height;
+	self->radius = (mask->height + 1) / 2 - 1;
+	self->stride = in->width + 2 * self->radius;
+	self->buffer = (ia_uint32_t*)malloc((ia_uint32_t)self->stride * (in->height + 2 * self->radius) * sizeof(ia_uint32_t));
+	for (i=0; i<2; i++)
+	{
+		self->offset[i] = (ia_int32_t*)malloc(size * sizeof(ia_int32_t));
+		self->weight[i] = (ia_uint32_t*)malloc(size * sizeof(ia_uint32_t));
+	}
+	if (!self->buffer || !self->offset[0] || !self->offset[1] || !self->weight[0] || !self->weight[1])
+	{
+		ia_distance_transform_chamfer_free(self);
+		return IA_FALSE;
+	}
+	for (i=0; i<2; i++)
+	{
+		self->count[i]      = ia_distance_transform_weights(mask, self->stride, !i, self->offset[i], self->weight[i]);
+		self->is_chained[i] = ia_distance_transform_chained(self->count[i], i ? -1 : 1, self->offset[i], self->radius);
+	}
+
+	self->origin = self->buffer + self->radius * self->stride + self->radius;
+	for (i=0; i<self->stride * (in->height + 2 * self->radius); i++)
+		self->buffer[i] = DT_INF;
+#pragma omp parallel for schedule(static)
+	for (y=0; y<in->height; y++)
+		memcpy(self->origin + y * self->stride, IA_IMAGE_ROW(in, y), in->width * sizeof(ia_uint32_t));
+	return IA_TRUE;
+}
+
+/* copies the distances back to the image and returns the maximum */
+static ia_uint32_t ia_distance_transform_chamfer_store(ia_distance_transform_chamfer_t* self, ia_image_p in)
+{
+	ia_int32_t  x, y;
+	ia_uint32_t max = 0;
+#pragma omp parallel
+	{
+		ia_uint32_t local = 0;
+#pragma omp for schedule(static)
+		for (y=0; y<self->height; y++)
+		{
+			const ia_uint32_t* row = self->origin + y * self->stride;
+			for (x=0; x<self->width; x++)
+				local = MAX(local, row[x]);
+			memcpy(IA_IMAGE_ROW(in, y), row, self->width * sizeof(ia_uint32_t));
+		}
+#pragma omp critical
+		max = MAX(max, local);
+	}
+	ia_distance_transform_chamfer_free(self);
+	return max;
+}
+
+/* pass over n pixels of a row from p, pass is 0 forward and 1 backward */
+static void ia_distance_transform_segment(ia_distance_transform_chamfer_t* self, ia_int32_t pass, ia_uint32_t* p, ia_int32_t n)
+{
+	ia_int32_t         step   = pass ? -1 : 1;
+	const ia_int32_t*  offset = self->offset[pass];
+	const ia_uint32_t* weight = self->weight[pass];
+
+	if (!self->is_chained[pass])
+		ia_distance_transform_row(p, n, step, offset, weight, self->count[pass]);
+	else if (self->count[pass] == 5)
+		ia_distance_transform_row_3(p, n, step, offset, weight);
+	else if (self->count[pass] == 9)
+		ia_distance_transform_row_5(p, n, step, offset, weight);
+	else
+		ia_distance_transform_row_7(p, n, step, offset, weight);
+}
+
+/* the first pixel of row y in the order of the pass */
+#define IA_DISTANCE_TRANSFORM_START(self, pass, y) \
+	((pass) ? (self)->origin + ((self)->height - 1 - (y)) * (self)->stride + (self)->width - 1 : (self)->origin + (y) * (self)->stride)
+
+static void ia_distance_transform_pass(ia_distance_transform_chamfer_t* self, ia_int32_t pass)
+{
+	ia_int32_t y;
+	for (y=0; y<self->height; y++)
+		ia_distance_transform_segment(self, pass, IA_DISTANCE_TRANSFORM_START(self, pass, y), self->width);
+}
+
+/* tiles of the wavefront, the columns are at least the rows times the mask radius */
+#define IA_DISTANCE_TILE_ROWS    32
+#define IA_DISTANCE_TILE_COLUMNS 128
+
+/*
+ * Tile (i, j) of the pass. The columns of each row in the tile start 
+ * radius pixels left of the row before, so a pixel needs from the rows 
+ * before in the tile only what is already done in it
+ */
+static void ia_distance_transform_tile(ia_distance_transform_chamfer_t* self, ia_int32_t pass, ia_int32_t i, ia_int32_t j, ia_int32_t columns)
+{
+	ia_int32_t step = pass ? -1 : 1;
+	ia_int32_t k, y, x0, x1;
+
+	for (k=0; k<IA_DISTANCE_TILE_ROWS; k++)
+	{
+		y = i * IA_DISTANCE_TILE_ROWS + k;
+		if (y >= self->height) break;
+		x0 = j * columns - k * self->radius;
+		x1 = MIN(x0 + columns, self->width);
+		x0 = MAX(x0, 0);
+		if (x0 < x1)
+			ia_distance_transform_segment(self, pass, IA_DISTANCE_TRANSFORM_START(self, pass, y) + step * x0, x1 - x0);
+	}
+}
+
+/*
+ * The pass on many threads as a wavefront over the tiles. Tile (i, j) 
+ * needs tile (i, j - 1) and the tiles up to (i - 1, j + 1) of the rows 
+ * before, all done before the wave 2 * i + j
+ */
+static void ia_distance_transform_wavefront(ia_distance_transform_chamfer_t* self, ia_int32_t pass)
+{
+	ia_int32_t columns = MAX(IA_DISTANCE_TILE_COLUMNS, IA_DISTANCE_TILE_ROWS * self->radius);
+	ia_int32_t rows    = (self->height + IA_DISTANCE_TILE_ROWS - 1) / IA_DISTANCE_TILE_ROWS;
+	ia_int32_t bands   = (self->width + (IA_DISTANCE_TILE_ROWS - 1) * self->radius + columns - 1) / columns;
+	ia_int32_t waves   = 2 * (rows - 1) + bands;
+
+#pragma omp parallel
+	{
+		ia_int32_t wave, i, first, last;
+		for (wave=0; wave<waves; wave++)
+		{
+			first = MAX(0, (wave - bands + 2) / 2);
+			last  = MIN(rows - 1, wave / 2);
+#pragma omp for schedule(static)
+			for (i=first; i<=last; i++)
+			{
+				ia_distance_transform_tile(self, pass, i, wave - 2 * i, columns);
+			}
+		}
+	}
+}
+
+/* 
+ * True if no pixel changes under the whole mask, what the two passes give
+ * for the masks of ia_distance_transform_mask with the usual weights
+ */
+static ia_bool_t ia_distance_transform_settled(ia_distance_transform_chamfer_t* self)
+{
+	ia_int32_t y, changed = 0;
+
+#pragma omp parallel
+	{
+		/* a mask weight at a time over the whole row */
+		ia_uint32_t* v = (ia_uint32_t*)malloc(self->width * sizeof(ia_uint32_t));
+#pragma omp for schedule(static) reduction(|:changed)
+		for (y=0; y<self->height; y++)
+		{
+			const ia_uint32_t* row = self->origin + y * self->stride;
+			const ia_uint32_t* p;
+			ia_uint32_t w;
+			ia_int32_t  x, i, k;
+			if (changed) continue;
+			if (!v)
+			{
+				/* a pixel at a time without memory for the row */
+				for (x=0; x<self->width; x++)
+				{
+					w = DT_INF;
+					for (i=0; i<2; i++)
+						for (k=0; k<self->count[i]; k++)
+							w = MIN(w, row[x + self->offset[i][k]] + self->weight[i][k]);
+					changed |= w != row[x];
+				}
+				continue;
+			}
+			for (x=0; x<self->width; x++)
+				v[x] = DT_INF;
+			for (i=0; i<2; i++)
+				for (k=0; k<self->count[i]; k++)
+				{
+					p = row + self->offset[i][k];
+					w = self->weight[i][k];
+					for (x=0; x<self->width; x++)
+						v[x] = MIN(v[x], p[x] + w);
+				}
+			for (x=0; x<self->width; x++)
+				changed |= v[x] != row[x];
+		}
+		free(v);
+	}
+	return !changed;
+}
+
+void ia_distance_transform_sequential(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
+{
+	ia_distance_transform_chamfer_t chamfer;
+
+	if ((in->format != IAT_INT_32 && in->format != IAT_UINT_32) || !ia_distance_transform_chamfer_load(&chamfer, in, mask))
+	{
+		ia_distance_transform_sequential_pixels(in, mask, min, max);
+		return;
+	}
+	ia_distance_transform_pass(&chamfer, 0);
+	ia_distance_transform_pass(&chamfer, 1);
+	*min = 0;
+	*max = ia_distance_transform_chamfer_store(&chamfer, in);
+}
+
+/*
+ * The two passes on many threads, repeated in the rare case they do not 
+ * settle the distances, to what the whole mask sweeps converge. The 
+ * maximum is limited to 0xFFFFFF as the sweeps do
+ */
+void ia_distance_transform_parallel(ia_image_p in, ia_image_p mask, ia_int32_t *min, ia_uint32_t *max)
+{
+	ia_distance_transform_chamfer_t chamfer;
+
+	if ((in->format != IAT_INT_32 && in->format != IAT_UINT_32) || !ia_distance_transform_chamfer_load(&chamfer, in, mask))
+	{
+		ia_distance_transform_parallel_pixels(in, mask, min, max);
+		return;
+	}
+	do
+	{
+		ia_distance_transform_wavefront(&chamfer, 0);
+		ia_distance_transform_wavefront(&chamfer, 1);
+	} while (!ia_distance_transform_settled(&chamfer));
+	*min = 0;
+	*max = ia_distance_transform_chamfer_store(&chamfer, in);
+	*max = MIN(*max, 0xFFFFFF);
+}
+
+/* marks with 1 the zero pixels of row y in [x0, x1) */
+static void ia_distance_transform_sources(ia_image_p image, ia_int32_t y, ia_int32_t x0, ia_int32_t x1, ia_uint8_t* line)
+{
+	const ia_uint8_t* row = IA_IMAGE_ROW(image, y);
+	ia_int32_t x;
+	if (image->format == IAT_BOOL)
+	{
+		for (x=x0; x<x1; x++)
+			line[x - x0] = !((row[x >> 3] >> (x & 7)) & 1);
+	}
+	else if (image->format == IAT_UINT_8 || image->format == IAT_INT_8)
+	{
+		for (x=x0; x<x1; x++)
+			line[x - x0] = !row[x];
+	}
+	else
+	{
+		for (x=x0; x<x1; x++)
+			line[x - x0] = !image->get_pixel(image, x, y);
+	}
+}
+
+/*
+ * Distance to the nearest zero pixel in the same column of rect, not less
+ * than inf if there is none, and the row of that pixel in features if not
+ * NULL, IA_MAX_UINT if none. Runs over bands of columns reading the rows 
+ * in order. Returns 0 if out of memory
+ */
+static ia_bool_t ia_distance_transform_columns(ia_image_p image, const ia_rect_t* rect, ia_image_p result, ia_image_p features, ia_uint32_t inf)
+{
+	ia_int32_t band, bands = (result->width + IA_DISTANCE_BAND - 1) / IA_DISTANCE_BAND;
+	ia_bool_t  failed = IA_FALSE;
+
+#pragma omp parallel
+	{
+		ia_uint8_t* line = (ia_uint8_t*)malloc(IA_DISTANCE_BAND);
+#pragma omp for schedule(static) reduction(|:failed)
+		for (band=0; band<bands; band++)
+		{
+			ia_int32_t   x, y, x0 = band * IA_DISTANCE_BAND;
+			ia_int32_t   n = MIN(result->width - x0, IA_DISTANCE_BAND);
+			ia_uint32_t *g, *prev, *r, *prev_r;
+
+			if (!line)
+			{
+				failed = IA_TRUE;
+				continue;
+			}
+			for (y=0; y<result->height; y++)
+			{
+				ia_distance_transform_sources(image, rect->t + y, rect->l + x0, rect->l + x0 + n, line);
+				g = (ia_uint32_t*)IA_IMAGE_ROW(result, y) + x0;
+				if (y)
+				{
+					prev = (ia_uint32_t*)IA_IMAGE_ROW(result, y - 1) + x0;
+					for (x=0; x<n; x++)
+						g[x] = line[x] ? 0 : prev[x] + 1;
+				}
+				else
+				{
+					for (x=0; x<n; x++)
+						g[x] = line[x] ? 0 : inf;
+				}
+				if (features)
+				{
+					r = (ia_uint32_t*)IA_IMAGE_ROW(features, y) + x0;
+					prev_r = y ? (ia_uint32_t*)IA_IMAGE_ROW(features, y - 1) + x0 : NULL;
+					for (x=0; x<n; x++)
+						r[x] = line[x] ? (ia_uint32_t)y : (prev_r ? prev_r[x] : IA_MAX_UINT);
+				}
+			}
+			for (y=result->height - 2; y>=0; y--)
+			{
+				g    = (ia_uint32_t*)IA_IMAGE_ROW(result, y) + x0;
+				prev = (ia_uint32_t*)IA_IMAGE_ROW(result, y + 1) + x0;
+				if (features)
+				{
+					r      = (ia_uint32_t*)IA_IMAGE_ROW(features, y) + x0;
+					prev_r = (ia_uint32_t*)IA_IMAGE_ROW(features, y + 1) + x0;
+					for (x=0; x<n; x++)
+						if (prev[x] + 1 < g[x])
+						{
+							g[x] = prev[x] + 1;
+							r[x] = prev_r[x];
+						}
+				}
+				else
+				{
+					for (x=0; x<n; x++)
+						g[x] = MIN(g[x], prev[x] + 1);
+				}
+			}
+		}
+		free(line);
+	}
+	return !failed;
+}
+
+/*
+ * Lower envelope of the parabolas (x - i)^2 + f(i) over a row after
+ * Meijster, Roerdink and Hesselink, f are the squared column distances 
+ * or DT_INF if none. s are the parabola centers, t where each one starts.
+ * Returns the index of the last one or -1 if all f are DT_INF
+ */
+static ia_int32_t ia_distance_transform_envelope(const ia_uint32_t* f, ia_int32_t width, ia_int32_t* s, ia_int32_t* t)
+{
+	ia_int32_t q = -1, u, d;
+	ia_int64_t sep;
+
+	for (u=0; u<width; u++)
+	{
+		if (f[u] == DT_INF) continue;
+		while (q >= 0)
+		{
+			d = t[q] - s[q];
+			sep = (ia_int64_t)d * d + f[s[q]];
+			d = t[q] - u;
+			if (sep <= (ia_int64_t)d * d + f[u]) break;
+			q--;
+		}
+		if (q < 0)
+		{
+			q    = 0;
+			s[0] = u;
+			t[0] = 0;
+		}
+		else
+		{
+			/* the first x where u is nearer than s[q], the numerator is not negative */
+			sep = (ia_int64_t)u * u - (ia_int64_t)s[q] * s[q] + f[u] - f[s[q]];
+			d   = 2 * (u - s[q]);
+			sep = 1 + (sep <= IA_MAX_INT ? (ia_int32_t)sep / d : sep / d);
+			if (sep < width)
+			{
+				q++;
+				s[q] = u;
+				t[q] = (ia_int32_t)sep;
+			}
+		}
+	}
+	return q;
+}
+
+/* the distances of the pixels in rect with the features if not NULL */
+static ia_image_p ia_distance_transform_exact(const char* name, ia_image_p image, ia_format_t format, const ia_rect_t* rect, ia_image_p* features)
+{
+	ia_image_p  result;
+	ia_image_p  nearest = NULL;
+	ia_int32_t  y, width, height;
+	ia_uint32_t inf;
+	ia_bool_t   columns, failed = IA_FALSE;
+
+	if (format != IAT_UINT_32 && format != IAT_FLOAT)
+	{
+		ASSERT(0), "%s -> Not supported format %s!\n", name, ia_format_name(format));
+		return NULL;
+	}
+	width  = rect->r - rect->l + 1;
+	height = rect->b - rect->t + 1;
+	result = ia_image_new(width, height, format, IA_IMAGE_GRAY);
+	if (features)
+	{
+		nearest = result ? ia_image_new(width, height, IAT_UINT_32, IA_IMAGE_GRAY) : NULL;
+		if (!nearest && result)
+		{
+			result->destroy(result);
+			result = NULL;
+		}
+		*features = nearest;
+	}
+	if (!result || !width || !height)
+	{
+		return result;
+	}
+	inf = (ia_uint32_t)width + height;
+
+	/* the column distances are kept in the result pixels, 32 bits in either format */
+	columns = ia_distance_transform_columns(image, rect, result, nearest, inf);
+
+#pragma omp parallel
+	{
+		ia_uint32_t* g = (ia_uint32_t*)malloc(width * sizeof(ia_uint32_t));
+		ia_uint32_t* r = features ? (ia_uint32_t*)malloc(width * sizeof(ia_uint32_t)) : NULL;
+		ia_int32_t*  s = (ia_int32_t*)malloc(width * sizeof(ia_int32_t));
+		ia_int32_t*  t = (ia_int32_t*)malloc(width * sizeof(ia_int32_t));
+#pragma omp for schedule(static) reduction(|:failed)
+		for (y=0; y<height; y++)
+		{
+			ia_uint32_t* row = (ia_uint32_t*)IA_IMAGE_ROW(result, y);
+			ia_float_t*  out = (ia_float_t*)row;
+			ia_uint32_t* index = features ? (ia_uint32_t*)IA_IMAGE_ROW(nearest, y) : NULL;
+			ia_int32_t   q, u;
+			ia_uint32_t  d;
+
+			if (!columns || !g || !s || !t || (features && !r))
+			{
+				failed = IA_TRUE;
+				continue;
+			}
+			for (u=0; u<width; u++)
+				g[u] = row[u] < inf ? row[u] * row[u] : DT_INF;
+			if (features)
+				memcpy(r, index, width * sizeof(ia_uint32_t));
+			q = ia_distance_transform_envelope(g, width, s, t);
+			for (u=width - 1; u>=0; u--)
+			{
+				if (q < 0)
+					d = DT_INF;
+				else
+					d = (ia_uint32_t)((u - s[q]) * (u - s[q])) + g[s[q]];
+				if (format == IAT_FLOAT)
+					out[u] = q < 0 ? (ia_float_t)DT_INF : (ia_float_t)sqrt((ia_double_t)d);
+				else
+					row[u] = d;
+				/* the index in image of the nearest zero pixel */
+				if (features)
+					index[u] = q < 0 ? IA_MAX_UINT : (rect->t + r[s[q]]) * (ia_uint32_t)image->width + rect->l + s[q];
+				if (q >= 0 && u == t[q]) q--;
+			}
+		}
+		free(g);
+		free(r);
+		free(s);
+		free(t);
+	}
+	if (failed)
+	{
+		/* not enough memory for the row buffers */
+		result->destroy(result);
+		if (nearest)
+		{
+			nearest->destroy(nearest);
+			*features = NULL;
+		}
+		return NULL;
+	}
+	return result;
+}
+
+ia_image_p ia_distance_transform_euclidean(ia_image_p image, ia_format_t format)
+{
+	ia_rect_t rect;
+	rect.l = 0;
+	rect.t = 0;
+	rect.r = image->width - 1;
+	rect.b = image->height - 1;
+	return ia_distance_transform_exact("ia_distance_transform_euclidean", image, format, &rect, NULL);
+}
+
+ia_image_p ia_distance_transform_feature(ia_image_p image, ia_format_t format, const ia_rect_t* rect, ia_image_p* features)
+{
+	ia_rect_t clipped;
+	clipped.l = 0;
+	clipped.t = 0;
+	clipped.r = image->width - 1;
+	clipped.b = image->height - 1;
+	if (rect)
+	{
+		clipped.l = MAX(rect->l, 0);
+		clipped.t = MAX(rect->t, 0);
+		clipped.r = MIN(rect->r, clipped.r);
+		clipped.b = MIN(rect->b, clipped.b);
+	}
+	*features = NULL;
+	if (clipped.l > clipped.r || clipped.t > clipped.b)
+	{
+		ASSERT(0), "ia_distance_transform_feature -> The rectangle is out of the image!\n");
+		return NULL;
+	}
+	return ia_distance_transform_exact("ia_distance_transform_feature", image, format, &clipped, features);
+}
+
+/* pixel waiting in ia_distance_transform_heap_t with its distance at the time */
+typedef struct
+{
+	ia_uint32_t key;
+	ia_uint32_t index;
+} ia_distance_transform_item_t;
+
+/* binary heap of pixels, the nearest first */
+typedef struct
+{
+	ia_distance_transform_item_t* items;
+	ia_int32_t                    count;
+	ia_int32_t                    size;
+} ia_distance_transform_heap_t;
+
+static ia_bool_t ia_distance_transform_push(ia_distance_transform_heap_t* heap, ia_uint32_t key, ia_uint32_t index)
+{
+	ia_int32_t i, parent;
+	if (heap->count == heap->size)
+	{
+		ia_int32_t size = heap->size ? 2 * heap->size : 256;
+		ia_distance_transform_item_t* items = (ia_distance_transform_item_t*)realloc(heap->items, size * sizeof(ia_distance_transform_item_t));
+		if (!items)
+			return IA_FALSE;
+		heap->items = items;
+		heap->size  = size;
+	}
+	for (i=heap->count++; i > 0 && heap->items[parent = (i - 1) >> 1].key > key; i = parent)
+		heap->items[i] = heap->items[parent];
+	heap->items[i].key   = key;
+	heap->items[i].index = index;
+	return IA_TRUE;
+}
+
+static ia_distance_transform_item_t ia_distance_transform_pop(ia_distance_transform_heap_t* heap)
+{
+	ia_distance_transform_item_t top  = heap->items[0];
+	ia_distance_transform_item_t last = heap->items[--heap->count];
+	ia_int32_t i = 0, child;
+	while ((child = 2 * i + 1) < heap->count)
+	{
+		if (child + 1 < heap->count && heap->items[child + 1].key < heap->items[child].key)
+			child++;
+		if (heap->items[child].key >= last.key)
+			break;
+		heap->items[i] = heap->items[child];
+		i = child;
+	}
+	if (heap->count)
+		heap->items[i] = last;
+	return top;
+}
+
+/* 
+ * Pixel q gets its distance from q + (dx, dy) plus weight. Returns the 
+ * count of the finite mask weights except the center
+ */
+static ia_int32_t ia_distance_transform_neighbors(ia_image_p mask, ia_int32_t* dx, ia_int32_t* dy, ia_uint32_t* weight)
+{
+	ia_int32_t center = (mask->height + 1) / 2 - 1;
+	ia_int32_t m, n, count = 0;
+	ia_uint32_t w;
+	for (n=0; n<mask->height; n++)
+	for (m=0; m<mask->width; m++)
+	{
+		w = mask->get_pixel(mask, m, n);
+		if (w == DT_INF || (n == center && m == center))
+			continue;
+		dx[count]     = m - center;
+		dy[count]     = n - center;
+		weight[count] = w;
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Raise and lower waves after Ramalingam and Reps. The removed sources and
+ * then every pixel left without a neighbor giving its distance are set to
+ * DT_INF in the order of their old distances. The pixels raised take the 
+ * best distance from their neighbors and together with the new sources 
+ * lower their neighbors in the order of Dijkstra
+ */
+void ia_distance_transform_update(ia_image_p image, ia_image_p mask, const ia_pos_t* added, ia_int32_t added_count, const ia_pos_t* removed, ia_int32_t removed_count)
+{
+	ia_distance_transform_heap_t heap;
+	ia_distance_transform_item_t item;
+	ia_uint32_t* d = (ia_uint32_t*)image->pixels.data;
+	ia_uint32_t* raised = NULL;
+	ia_uint32_t  raised_count = 0, raised_size = 0;
+	ia_int32_t*  dx;
+	ia_int32_t*  dy;
+	ia_uint32_t* weight;
+	ia_int32_t   count, i, k, x, y, qx, qy;
+	ia_uint32_t  p, q, v;
+	ia_bool_t    ok = IA_TRUE;
+
+	if (image->format != IAT_INT_32 && image->format != IAT_UINT_32)
+	{
+		ASSERT(0), "ia_distance_transform_update -> Not supported format %s!\n", ia_format_name(image->format));
+		return;
+	}
+	dx     = (ia_int32_t*)malloc(mask->width * mask->height * sizeof(ia_int32_t));
+	dy     = (ia_int32_t*)malloc(mask->width * mask->height * sizeof(ia_int32_t));
+	weight = (ia_uint32_t*)malloc(mask->width * mask->height * sizeof(ia_uint32_t));
+	if (!dx || !dy || !weight)
+	{
+		free(dx);
+		free(dy);
+		free(weight);
+		return;
+	}
+	count = ia_distance_transform_neighbors(mask, dx, dy, weight);
+	heap.items = NULL;
+	heap.count = 0;
+	heap.size  = 0;
+
+#define IA_DISTANCE_TRANSFORM_INSIDE(x, y) ((x) >= 0 && (y) >= 0 && (x) < image->width && (y) < image->height)
+
+	/* raise */
+	for (i=0; i<removed_count && ok; i++)
+	{
+		if (IA_DISTANCE_TRANSFORM_INSIDE(removed[i].x, removed[i].y))
+		{
+			p = removed[i].y * image->width + removed[i].x;
+			if (!d[p]) ok = ia_distance_transform_push(&heap, 0, p);
+		}
+	}
+	while (heap.count && ok)
+	{
+		item = ia_distance_transform_pop(&heap);
+		p = item.index;
+		if (d[p] != item.key)
+			continue;
+		x = p % image->width;
+		y = p / image->width;
+		if (item.key)
+		{
+			/* still given by a neighbor not raised */
+			for (k=0; k<count; k++)
+			{
+				qx = x + dx[k];
+				qy = y + dy[k];
+				if (IA_DISTANCE_TRANSFORM_INSIDE(qx, qy) && d[qy * image->width + qx] != DT_INF && 
+					d[qy * image->width + qx] + weight[k] == item.key)
+					break;
+			}
+			if (k < count)
+				continue;
+		}
+		d[p] = DT_INF;
+		if (raised_count == raised_size)
+		{
+			ia_uint32_t* more;
+			raised_size = raised_size ? 2 * raised_size : 256;
+			more = (ia_uint32_t*)realloc(raised, raised_size * sizeof(ia_uint32_t));
+			if (!more)
+			{
+				ok = IA_FALSE;
+				break;
+			}
+			raised = more;
+		}
+		raised[raised_count++] = p;
+		/* the pixels which could have their distances from p */
+		for (k=0; k<count && ok; k++)
+		{
+			qx = x - dx[k];
+			qy = y - dy[k];
+			if (IA_DISTANCE_TRANSFORM_INSIDE(qx, qy))
+			{
+				q = qy * image->width + qx;
+				if (d[q] && d[q] != DT_INF && d[q] == item.key + weight[k])
+					ok = ia_distance_transform_push(&heap, d[q], q);
+			}
+		}
+	}
+
+	/* lower */
+	heap.count = 0;
+	for (i=0; i<(ia_int32_t)raised_count && ok; i++)
+	{
+		p = raised[i];
+		x = p % image->width;
+		y = p / image->width;
+		v = DT_INF;
+		for (k=0; k<count; k++)
+		{
+			qx = x + dx[k];
+			qy = y + dy[k];
+			if (IA_DISTANCE_TRANSFORM_INSIDE(qx, qy))
+				v = MIN(v, d[qy * image->width + qx] + weight[k]);
+		}
+		if (v < d[p])
+		{
+			d[p] = v;
+			ok = ia_distance_transform_push(&heap, v, p);
+		}
+	}
+	for (i=0; i<added_count && ok; i++)
+	{
+		if (IA_DISTANCE_TRANSFORM_INSIDE(added[i].x, added[i].y))
+		{
+			p = added[i].y * image->width + added[i].x;
+			d[p] = 0;
+			ok = ia_distance_transform_push(&heap, 0, p);
+		}
+	}
+	while (heap.count && ok)
+	{
+		item = ia_distance_transform_pop(&heap);
+		p = item.index;
+		if (d[p] != item.key)
+			continue;
+		x = p % image->width;
+		y = p / image->width;
+		for (k=0; k<count && ok; k++)
+		{
+			qx = x - dx[k];
+			qy = y - dy[k];
+			if (IA_DISTANCE_TRANSFORM_INSIDE(qx, qy))
+			{
+				q = qy * image->width + qx;
+				v = item.key + weight[k];
+				if (v < d[q])
+				{
+					d[q] = v;
+					ok = ia_distance_transform_push(&heap, v, q);
+				}
+			}
+		}
+	}
+#undef IA_DISTANCE_TRANSFORM_INSIDE
+
+	if (!ok)
+	{
+		ASSERT(0), "ia_distance_transform_update -> Out of memory!\n");
+	}
+	free(heap.items);
+	free(raised);
+	free(dx);
+	free(dy);
+	free(weight);
+}
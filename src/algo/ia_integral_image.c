@@ -0,0 +1,313 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_integral_image.c                                */
+/* Description:   Integral image (summed-area table)                 */
+/*                                                                   */
+/*********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ia/ia_pixels.h>
+#include <ia/algo/ia_integral_image.h>
+
+/* columns per band of the vertical pass */
+#define IA_INTEGRAL_BAND 256
+
+/*
+ * First pass, the prefix sums of the image row y go to the table row y+1.
+ * The rows are independent.
+ */
+static void ia_integral_image_row(ia_integral_image_p self, ia_image_p image, ia_int32_t y, void* buffer)
+{
+	ia_int32_t x;
+	ia_uint32_t ofs = (ia_uint32_t)(y + 1) * self->stride;
+	const ia_uint8_t*  row8  = NULL;
+	const ia_int32_t*  row32 = (const ia_int32_t*)buffer;
+	const ia_double_t* rowd  = (const ia_double_t*)buffer;
+
+	if (image->format == IAT_UINT_8)
+	{
+		row8 = IA_IMAGE_ROW(image, y);
+	}
+	else if (self->type == IA_INTEGRAL_DOUBLE)
+	{
+		ia_pixels_convert(IA_IMAGE_ROW(image, y), image->format, buffer, IAT_DOUBLE, self->width, 1.0, 0.0);
+	}
+	else
+	{
+		ia_pixels_convert(IA_IMAGE_ROW(image, y), image->format, buffer, 
+			image->format == IAT_UINT_32 ? IAT_UINT_32 : IAT_INT_32, self->width, 1.0, 0.0);
+	}
+
+	switch (self->type)
+	{
+		case IA_INTEGRAL_32:
+		{
+			ia_uint32_t* sum = (ia_uint32_t*)self->sum + ofs;
+			ia_uint32_t s = 0;
+			sum[0] = 0;
+			for (x=0; x<self->width; x++)
+			{
+				s += row8 ? row8[x] : (ia_uint32_t)row32[x];
+				sum[x+1] = s;
+			}
+			if (self->sqsum)
+			{
+				ia_uint32_t* sq = (ia_uint32_t*)self->sqsum + ofs;
+				sq[0] = s = 0;
+				for (x=0; x<self->width; x++)
+				{
+					ia_uint32_t v = row8 ? row8[x] : (ia_uint32_t)row32[x];
+					s += v * v;
+					sq[x+1] = s;
+				}
+			}
+		}
+		break;
+		case IA_INTEGRAL_64:
+		{
+			ia_uint64_t* sum = (ia_uint64_t*)self->sum + ofs;
+			ia_uint64_t s = 0;
+			sum[0] = 0;
+			for (x=0; x<self->width; x++)
+			{
+				s += row8 ? row8[x] : (ia_uint64_t)(self->is_signed ? (ia_int64_t)row32[x] : (ia_int64_t)(ia_uint32_t)row32[x]);
+				sum[x+1] = s;
+			}
+			if (self->sqsum)
+			{
+				ia_uint64_t* sq = (ia_uint64_t*)self->sqsum + ofs;
+				sq[0] = s = 0;
+				for (x=0; x<self->width; x++)
+				{
+					ia_int64_t v = row8 ? row8[x] : (self->is_signed ? (ia_int64_t)row32[x] : (ia_int64_t)(ia_uint32_t)row32[x]);
+					s += (ia_uint64_t)v * (ia_uint64_t)v;
+					sq[x+1] = s;
+				}
+			}
+		}
+		break;
+		default: /* IA_INTEGRAL_DOUBLE */
+		{
+			ia_double_t* sum = (ia_double_t*)self->sum + ofs;
+			ia_double_t s = 0.0;
+			sum[0] = 0.0;
+			for (x=0; x<self->width; x++)
+			{
+				s += row8 ? row8[x] : rowd[x];
+				sum[x+1] = s;
+			}
+			if (self->sqsum)
+			{
+				ia_double_t* sq = (ia_double_t*)self->sqsum + ofs;
+				sq[0] = s = 0.0;
+				for (x=0; x<self->width; x++)
+				{
+					ia_double_t v = row8 ? row8[x] : rowd[x];
+					s += v * v;
+					sq[x+1] = s;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Second pass, each table row adds the row above it. The columns are
+ * independent, so the work is split in vertical bands which keep the
+ * two rows of the band in cache.
+ */
+static void ia_integral_image_band(ia_integral_image_p self, void* table, ia_uint32_t x0, ia_uint32_t x1)
+{
+	ia_uint32_t x, y;
+	for (y=2; y<=self->height; y++)
+	{
+		ia_uint32_t ofs = y * self->stride, prev = ofs - self->stride;
+		switch (self->type)
+		{
+			case IA_INTEGRAL_32:
+			{
+				ia_uint32_t* t = (ia_uint32_t*)table;
+				for (x=x0; x<x1; x++) t[ofs + x] += t[prev + x];
+			}
+			break;
+			case IA_INTEGRAL_64:
+			{
+				ia_uint64_t* t = (ia_uint64_t*)table;
+				for (x=x0; x<x1; x++) t[ofs + x] += t[prev + x];
+			}
+			break;
+			default:
+			{
+				ia_double_t* t = (ia_double_t*)table;
+				for (x=x0; x<x1; x++) t[ofs + x] += t[prev + x];
+			}
+		}
+	}
+}
+
+static ia_bool_t ia_integral_image_clip(ia_integral_image_p self, const ia_rect_t* rect, ia_rect_t* clipped)
+{
+	clipped->l = MAX(rect->l, 0);
+	clipped->t = MAX(rect->t, 0);
+	clipped->r = MIN(rect->r, (ia_int32_t)self->width - 1);
+	clipped->b = MIN(rect->b, (ia_int32_t)self->height - 1);
+	return (clipped->l <= clipped->r && clipped->t <= clipped->b);
+}
+
+static ia_double_t ia_integral_image_table_sum(ia_integral_image_p self, void* table, const ia_rect_t* rect)
+{
+	ia_rect_t rc;
+	if (!table || !ia_integral_image_clip(self, rect, &rc))
+	{
+		return 0.0;
+	}
+
+	switch (self->type)
+	{
+		case IA_INTEGRAL_32:
+		{
+			ia_uint32_t s = IA_INTEGRAL_RECT((ia_uint32_t*)table, self->stride, rc.l, rc.t, rc.r, rc.b);
+			return self->is_signed && table == self->sum ? (ia_double_t)(ia_int32_t)s : (ia_double_t)s;
+		}
+		case IA_INTEGRAL_64:
+		{
+			ia_uint64_t s = IA_INTEGRAL_RECT((ia_uint64_t*)table, self->stride, rc.l, rc.t, rc.r, rc.b);
+			return self->is_signed && table == self->sum ? (ia_double_t)(ia_int64_t)s : (ia_double_t)s;
+		}
+		default:
+			return IA_INTEGRAL_RECT((ia_double_t*)table, self->stride, rc.l, rc.t, rc.r, rc.b);
+	}
+}
+
+static ia_double_t ia_integral_image_rect_sum(ia_integral_image_p self, const ia_rect_t* rect)
+{
+	return ia_integral_image_table_sum(self, self->sum, rect);
+}
+
+static ia_double_t ia_integral_image_rect_sqsum(ia_integral_image_p self, const ia_rect_t* rect)
+{
+	return ia_integral_image_table_sum(self, self->sqsum, rect);
+}
+
+static void ia_integral_image_rect_mean_variance(ia_integral_image_p self, const ia_rect_t* rect, ia_double_t* mean, ia_double_t* variance)
+{
+	ia_rect_t rc;
+	ia_double_t area;
+	*mean = 0.0;
+	if (variance)
+	{
+		*variance = 0.0;
+	}
+	if (!ia_integral_image_clip(self, rect, &rc))
+	{
+		return ;
+	}
+
+	area  = (ia_double_t)(rc.r - rc.l + 1) * (rc.b - rc.t + 1);
+	*mean = ia_integral_image_table_sum(self, self->sum, &rc) / area;
+	if (variance && self->sqsum)
+	{
+		*variance = ia_integral_image_table_sum(self, self->sqsum, &rc) / area - (*mean) * (*mean);
+		if (*variance < 0.0)
+		{
+			/* rounding of the double sums */
+			*variance = 0.0;
+		}
+	}
+}
+
+static void ia_integral_image_destroy(ia_integral_image_p self)
+{
+	free(self->sum);
+	if (self->sqsum)
+	{
+		free(self->sqsum);
+	}
+	free(self);
+}
+
+ia_integral_image_p ia_integral_image_new(ia_image_p image, ia_integral_t type, ia_bool_t with_sqsum)
+{
+	ia_int32_t i;
+	size_t size;
+	ia_bool_t failed = IA_FALSE;
+	ia_integral_image_p self;
+
+	if (!image->is_gray)
+	{
+		ASSERT(0), "FIXME: RGB format is not supported by ia_integral_image_new!\n");
+		return NULL;
+	}
+
+	self = (ia_integral_image_p)malloc(sizeof(ia_integral_image_t));
+	if (!self)
+	{
+		return NULL;
+	}
+	self->width              = image->width;
+	self->height             = image->height;
+	self->type               = type;
+	self->is_signed          = ia_format_signed(image->format);
+	self->stride             = (ia_uint32_t)image->width + 1;
+	self->rect_sum           = ia_integral_image_rect_sum;
+	self->rect_sqsum         = ia_integral_image_rect_sqsum;
+	self->rect_mean_variance = ia_integral_image_rect_mean_variance;
+	self->destroy            = ia_integral_image_destroy;
+
+	size = (size_t)self->stride * ((size_t)image->height + 1) * (type == IA_INTEGRAL_32 ? sizeof(ia_uint32_t) : sizeof(ia_uint64_t));
+	self->sum   = malloc(size);
+	self->sqsum = with_sqsum ? malloc(size) : NULL;
+	if (!self->sum || (with_sqsum && !self->sqsum))
+	{
+		if (self->sum) free(self->sum);
+		if (self->sqsum) free(self->sqsum);
+		free(self);
+		return NULL;
+	}
+
+	/* the first row is 0, the first column is written by the row pass */
+	memset(self->sum, 0, self->stride * (type == IA_INTEGRAL_32 ? sizeof(ia_uint32_t) : sizeof(ia_uint64_t)));
+	if (self->sqsum)
+	{
+		memset(self->sqsum, 0, self->stride * (type == IA_INTEGRAL_32 ? sizeof(ia_uint32_t) : sizeof(ia_uint64_t)));
+	}
+
+#pragma omp parallel
+	{
+		void* buffer = malloc(image->width * sizeof(ia_double_t));
+#pragma omp for schedule(static) reduction(|:failed)
+		for (i=0; i<image->height; i++)
+		{
+			if (!buffer)
+			{
+				failed = IA_TRUE;
+				continue;
+			}
+			ia_integral_image_row(self, image, i, buffer);
+		}
+		free(buffer);
+	}
+	if (failed)
+	{
+		/* not enough memory for the row buffers */
+		ia_integral_image_destroy(self);
+		return NULL;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (i=0; i<(ia_int32_t)((self->stride + IA_INTEGRAL_BAND - 1) / IA_INTEGRAL_BAND); i++)
+	{
+		ia_uint32_t x0 = i * IA_INTEGRAL_BAND;
+		ia_uint32_t x1 = MIN(x0 + IA_INTEGRAL_BAND, self->stride);
+		ia_integral_image_band(self, self->sum, x0, x1);
+		if (self->sqsum)
+		{
+			ia_integral_image_band(self, self->sqsum, x0, x1);
+		}
+	}
+	return self;
+}
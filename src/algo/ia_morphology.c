@@ -9,41 +9,1319 @@
 /*********************************************************************/
 #include <malloc.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <math.h>
 #include <ia/algo/ia_morphology.h>
 
-ia_image_p ia_morphology_dilation(ia_image_p image, ia_image_p structure)
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Structuring elements. A rectangle with all pixels set, including the 
+ * horizontal and vertical lines, is separable to a row and a column 
+ * pass with a running extremum. The diagonals are odd squares with the 
+ * pixels (i, i) or (n-1-i, i) set only. The rows are kept as runs of 
+ * set pixels and the rows with the same pixels share a pattern, so the 
+ * horizontal pass is done once for all of them
+ */
+static const ia_int32_t* ia_structure_offsets(ia_structure_p self, ia_int32_t stride)
+{
+	ia_int32_t i;
+	if (self->stride != stride)
+	{
+		for (i=0; i<self->count; i++)
+			self->offset[i] = self->dy[i] * stride + self->dx[i];
+		self->stride = stride;
+	}
+	return self->offset;
+}
+
+static void ia_structure_destroy(ia_structure_p self)
+{
+	ia_int32_t i;
+	for (i=0; i<self->factors; i++)
+	{
+		if (self->factor[i])
+		{
+			self->factor[i]->destroy(self->factor[i]);
+		}
+	}
+	free(self->factor);
+	free(self->dx);
+	free(self->pattern);
+	free(self);
+}
+
+static ia_structure_p ia_structure_compile(const ia_uint8_t*, ia_int32_t, ia_int32_t);
+
+/*
+ * Rough cost of a dilation by the element in SIMD passes over the image. 
+ * By the runs a run of L pixels takes log2(L) doubling passes and every 
+ * row one more. The scalar row running extremum counts as several 
+ * passes and every decomposition element allocates one more image
+ */
+static ia_int32_t ia_structure_runs_cost(ia_structure_p self)
+{
+	ia_int32_t i, n, p, length, cost = 0;
+	for (p=0, i=0; i<self->height; i++)
+	{
+		if (self->pattern[i] < 0)
+		{
+			continue;
+		}
+		cost++;
+		if (self->pattern[i] == p)
+		{
+			/* the first row of a pattern */
+			p++;
+			for (n=0; n<self->runs[i]; n++)
+				for (cost++, length=1; length<self->lengths[i * self->width + n]; length*=2)
+					cost++;
+		}
+	}
+	return cost;
+}
+
+static ia_int32_t ia_structure_cost(ia_structure_p self)
+{
+	ia_int32_t i, cost;
+	switch (self->shape)
+	{
+	case IA_STRUCTURE_RECT:
+		return (self->width > 1 ? 48 : 0) + (self->height > 1 ? 13 : 0);
+	case IA_STRUCTURE_DIAGONAL:
+	case IA_STRUCTURE_ANTIDIAGONAL:
+		return 15;
+	case IA_STRUCTURE_DIAMOND:
+	case IA_STRUCTURE_OCTAGON:
+		for (cost=11, i=0; i<self->factors; i++)
+			cost += MIN(ia_structure_cost(self->factor[i]), ia_structure_runs_cost(self->factor[i])) + 7;
+		return cost;
+	default:
+		return ia_structure_runs_cost(self);
+	}
+}
+
+/*
+ * An odd w x h element is the rectangle (2a+1) x (2c+1) dilated by the 
+ * diamond |dx| + |dy| <= b if its pixels are those within distance b 
+ * from the rectangle, max(|dx|-a, 0) + max(|dy|-c, 0) <= b. The two 
+ * diagonals of 2k+1 pixels sum to the points of even dx+dy within 
+ * |dx| + |dy| <= 2k and a 3x3 cross fills the diamond of 2k+1, one 
+ * more cross makes 2k+2. So all but the crosses take constant time
+ */
+static void ia_structure_decompose(ia_structure_p self, const ia_uint8_t* se)
+{
+	ia_int32_t sw = self->width, sh = self->height;
+	ia_int32_t w2 = sw >> 1, h2 = sh >> 1;
+	ia_int32_t a, b, c, k, x, y, i, n = 0;
+	ia_uint8_t* mask;
+	static const ia_uint8_t cross[9] = { 0, 1, 0, 1, 1, 1, 0, 1, 0 };
+
+	if (!(sw & 1) || !(sh & 1))
+	{
+		return;
+	}
+	for (b=1; b<=MIN(w2, h2); b++)
+	{
+		ia_bool_t match = IA_TRUE;
+		a = w2 - b;
+		c = h2 - b;
+		for (y=-h2; y<=h2 && match; y++)
+			for (x=-w2; x<=w2 && match; x++)
+			{
+				ia_bool_t inside = (ia_bool_t)(MAX(abs(x) - a, 0) + MAX(abs(y) - c, 0) <= b);
+				match = (ia_bool_t)(inside == (se[(y + h2) * sw + x + w2] != 0));
+			}
+		if (match)
+		{
+			break;
+		}
+	}
+	if (b > MIN(w2, h2) || (!a && !c && b == 1))
+	{
+		/* not an octagon or the cross itself */
+		return;
+	}
+
+	k = (b - 1) >> 1;
+	mask = (ia_uint8_t*)calloc(sw * sh, 1);
+	self->factor = (ia_structure_p*)calloc(5, sizeof(ia_structure_p));
+	if (mask && self->factor)
+	{
+		if (a || c)
+		{
+			memset(mask, 1, (2 * a + 1) * (2 * c + 1));
+			self->factor[n++] = ia_structure_compile(mask, 2 * a + 1, 2 * c + 1);
+		}
+		if (k)
+		{
+			memset(mask, 0, sw * sh);
+			for (i=0; i<2 * k + 1; i++)
+				mask[i * (2 * k + 1) + i] = 1;
+			self->factor[n++] = ia_structure_compile(mask, 2 * k + 1, 2 * k + 1);
+			memset(mask, 0, sw * sh);
+			for (i=0; i<2 * k + 1; i++)
+				mask[i * (2 * k + 1) + 2 * k - i] = 1;
+			self->factor[n++] = ia_structure_compile(mask, 2 * k + 1, 2 * k + 1);
+		}
+		self->factor[n++] = ia_structure_compile(cross, 3, 3);
+		if (!(b & 1))
+		{
+			self->factor[n++] = ia_structure_compile(cross, 3, 3);
+		}
+	}
+	free(mask);
+	self->factors = n;
+	for (i=0; i<n && self->factor[i]; i++);
+	if (n && i == n)
+	{
+		self->shape = a || c ? IA_STRUCTURE_OCTAGON : IA_STRUCTURE_DIAMOND;
+		if (ia_structure_cost(self) < ia_structure_runs_cost(self))
+		{
+			return;
+		}
+	}
+
+	/* out of memory or the runs are cheaper, the element stays general */
+	self->shape = IA_STRUCTURE_GENERAL;
+	for (i=0; i<n; i++)
+	{
+		if (self->factor[i])
+		{
+			self->factor[i]->destroy(self->factor[i]);
+		}
+	}
+	free(self->factor);
+	self->factor  = NULL;
+	self->factors = 0;
+}
+
+/* compiles w x h element given as bytes, nonzero for the set pixels */
+static ia_structure_p ia_structure_compile(const ia_uint8_t* se, ia_int32_t sw, ia_int32_t sh)
 {
-	ia_int32_t i, j, k, l, w2 = (structure->width >> 1), h2 = (structure->height >> 1);
-	ia_image_p output = ia_image_new(image->width, image->height, image->format, IA_IMAGE_GRAY);
-	output->fill(output, 0);
+	ia_int32_t w2 = sw >> 1, h2 = sh >> 1, n = sw;
+	ia_int32_t i, j, y, count = 0;
+	ia_bool_t  rect = IA_TRUE;
+	ia_bool_t  diagonal = (ia_bool_t)(n == sh && (n & 1));
+	ia_bool_t  anti = diagonal;
+	ia_structure_p self = (ia_structure_p)calloc(1, sizeof(ia_structure_t));
+	if (!self)
+	{
+		return NULL;
+	}
+
+	for (i=0; i<sw * sh; i++)
+		count += se[i] != 0;
+
+	self->width    = sw;
+	self->height   = sh;
+	self->count    = count;
+	self->dx       = (ia_int32_t*)malloc(3 * MAX(count, 1) * sizeof(ia_int32_t));
+	self->pattern  = (ia_int32_t*)malloc(sh * (2 * sw + 2) * sizeof(ia_int32_t));
+	self->offsets  = ia_structure_offsets;
+	self->destroy  = ia_structure_destroy;
+	if (!self->dx || !self->pattern)
+	{
+		ia_structure_destroy(self);
+		return NULL;
+	}
+	self->dy      = self->dx + count;
+	self->offset  = self->dy + count;
+	self->runs    = self->pattern + sh;
+	self->starts  = self->runs + sh;
+	self->lengths = self->starts + sh * sw;
+
+	for (count=0, i=0; i<sh; i++)
+		for (j=0; j<sw; j++)
+		{
+			ia_bool_t set = (ia_bool_t)(se[i * sw + j] != 0);
+			if (set)
+			{
+				self->dx[count]     = j - w2;
+				self->dy[count]     = i - h2;
+				self->offset[count] = j - w2;
+				count++;
+			}
+			rect     &= set;
+			diagonal &= set == (i == j);
+			anti     &= set == (i == n - 1 - j);
+		}
 
-	for (i=-h2; i<((structure->height+1) >> 1); i++)
-		for (j=-w2; j<((structure->width+1) >> 1); j++)
-			if (structure->get_pixel(structure, w2+j, h2+i))
-				for (k=0; k<image->height; k++)
-					for (l=0; l<image->width; l++)
+	for (i=0; i<sh; i++)
+	{
+		const ia_uint8_t* line = se + i * sw;
+		ia_int32_t* runs = self->runs + i;
+		*runs = 0;
+		for (j=0; j<sw; j++)
+		{
+			if (line[j] && (j == 0 || !line[j - 1]))
+			{
+				self->starts[i * sw + *runs]  = j;
+				self->lengths[i * sw + *runs] = 0;
+				(*runs)++;
+			}
+			if (line[j])
+			{
+				self->lengths[i * sw + *runs - 1]++;
+			}
+		}
+		self->pattern[i] = -1;
+		if (*runs)
+		{
+			for (y=0; y<i && self->pattern[i] < 0; y++)
+			{
+				if (self->runs[y] && !memcmp(line, se + y * sw, sw))
+				{
+					self->pattern[i] = self->pattern[y];
+				}
+			}
+			if (self->pattern[i] < 0)
+			{
+				self->pattern[i] = self->patterns++;
+			}
+		}
+	}
+
+	if (rect)
+		self->shape = IA_STRUCTURE_RECT;
+	else if (diagonal)
+		self->shape = IA_STRUCTURE_DIAGONAL;
+	else if (anti)
+		self->shape = IA_STRUCTURE_ANTIDIAGONAL;
+	else
+		ia_structure_decompose(self, se);
+	return self;
+}
+
+ia_structure_p ia_structure_new(ia_image_p image)
+{
+	ia_int32_t  i, j;
+	ia_uint8_t* se = (ia_uint8_t*)malloc(image->width * image->height);
+	ia_structure_p self;
+	if (!se)
+	{
+		return NULL;
+	}
+	for (i=0; i<image->height; i++)
+		for (j=0; j<image->width; j++)
+			se[i * image->width + j] = (ia_uint8_t)(image->get_pixel(image, j, i) != 0);
+	self = ia_structure_compile(se, image->width, image->height);
+	free(se);
+	return self;
+}
+
+/*
+ * van Herk/Gil-Werman running maximum. The m values, m multiple of k, are 
+ * split in blocks of k, forward keeps the maximums from each block start 
+ * and backward those to each block end, so the maximum of any k values 
+ * starting at x is max(backward[x], forward[x + k - 1]), 3 comparisons 
+ * per value whatever k is. The minimum is the maximum of the complement
+ */
+static void ia_morphology_van_herk(const ia_uint16_t* p, ia_int32_t m, ia_int32_t k, 
+								   ia_uint16_t* forward, ia_uint16_t* backward)
+{
+	ia_int32_t q, e;
+	for (q=0; q<m; q+=k)
+	{
+		forward[q] = p[q];
+		for (e=q + 1; e<q + k; e++)
+		{
+			forward[e] = MAX(forward[e - 1], p[e]);
+		}
+		backward[q + k - 1] = p[q + k - 1];
+		for (e=q + k - 2; e>=q; e--)
+		{
+			backward[e] = MAX(backward[e + 1], p[e]);
+		}
+	}
+}
+
+/* dst = max(a, b) or min(a, b) of 8 or 16-bit elements */
+static void ia_morphology_rows(void* dst, const void* a, const void* b, ia_int32_t count, ia_int32_t depth, ia_bool_t is_max)
+{
+	ia_int32_t i = 0;
+	if (depth == 8)
+	{
+		ia_uint8_t* d = (ia_uint8_t*)dst;
+		const ia_uint8_t* s = (const ia_uint8_t*)a;
+		const ia_uint8_t* t = (const ia_uint8_t*)b;
+#ifdef __SSE2__
+		for (; i + 16 <= count; i+=16)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(s + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(t + i));
+			_mm_storeu_si128((__m128i*)(d + i), is_max ? _mm_max_epu8(va, vb) : _mm_min_epu8(va, vb));
+		}
+#endif
+		if (is_max)
+			for (; i<count; i++) d[i] = MAX(s[i], t[i]);
+		else
+			for (; i<count; i++) d[i] = MIN(s[i], t[i]);
+	}
+	else
+	{
+		ia_uint16_t* d = (ia_uint16_t*)dst;
+		const ia_uint16_t* s = (const ia_uint16_t*)a;
+		const ia_uint16_t* t = (const ia_uint16_t*)b;
+#ifdef __SSE2__
+		/* no unsigned 16-bit max and min before SSE4.1, saturated difference instead */
+		for (; i + 8 <= count; i+=8)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(s + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(t + i));
+			__m128i diff = _mm_subs_epu16(va, vb);
+			_mm_storeu_si128((__m128i*)(d + i), is_max ? _mm_add_epi16(vb, diff) : _mm_sub_epi16(va, diff));
+		}
+#endif
+		if (is_max)
+			for (; i<count; i++) d[i] = MAX(s[i], t[i]);
+		else
+			for (; i<count; i++) d[i] = MIN(s[i], t[i]);
+	}
+}
+
+/*
+ * Running extremum of k values along lines of the image. A line of n 
+ * pixels starts at (x, y) and steps by (dx, dy), output x takes the 
+ * source values [x - a, x - a + k - 1], the pixels out of the image 
+ * do not count
+ */
+static void ia_morphology_line(ia_image_p src, ia_image_p dst, ia_int32_t x, ia_int32_t y, ia_int32_t dx, ia_int32_t dy, 
+							   ia_int32_t n, ia_int32_t k, ia_int32_t a, ia_bool_t is_max, ia_uint16_t* buffer)
+{
+	ia_int32_t  m = ((n + k - 1 + k - 1) / k) * k;
+	ia_int32_t  q, step = dy * (ia_int32_t)IA_IMAGE_STRIDE(src);
+	ia_uint16_t* p        = buffer;
+	ia_uint16_t* forward  = p + m;
+	ia_uint16_t* backward = forward + m;
+
+	for (q=0; q<a && q<m; q++)
+	{
+		p[q] = 0;
+	}
+	for (q=n + a; q<m; q++)
+	{
+		p[q] = 0;
+	}
+	if (src->format == IAT_UINT_8)
+	{
+		const ia_uint8_t* s = IA_IMAGE_ROW(src, y) + x;
+		ia_uint8_t*       d = IA_IMAGE_ROW(dst, y) + x;
+		ia_uint8_t mask = is_max ? 0 : 0xFF;
+		step += dx;
+		for (q=0; q<n; q++)
+		{
+			p[q + a] = s[q * step] ^ mask;
+		}
+		ia_morphology_van_herk(p, m, k, forward, backward);
+		for (q=0; q<n; q++)
+		{
+			d[q * step] = (ia_uint8_t)(MAX(backward[q], forward[q + k - 1]) ^ mask);
+		}
+	}
+	else
+	{
+		const ia_uint8_t* s = IA_IMAGE_ROW(src, y) + 2 * x;
+		ia_uint8_t*       d = IA_IMAGE_ROW(dst, y) + 2 * x;
+		ia_uint16_t mask = is_max ? 0 : 0xFFFF;
+		step += 2 * dx;
+		for (q=0; q<n; q++)
+		{
+			p[q + a] = *(const ia_uint16_t*)(s + q * step) ^ mask;
+		}
+		ia_morphology_van_herk(p, m, k, forward, backward);
+		for (q=0; q<n; q++)
+		{
+			*(ia_uint16_t*)(d + q * step) = (ia_uint16_t)(MAX(backward[q], forward[q + k - 1]) ^ mask);
+		}
+	}
+}
+
+/*
+ * Running extremum of k rows, in column strips of the image. With a 
+ * shear of 1 or -1 the strip follows the diagonal or the antidiagonal, 
+ * row y is read at the columns u + shear*y of the strip columns u, so 
+ * every row is still read contiguously
+ */
+#define IA_MORPHOLOGY_STRIP 256
+
+/* count pixels of row y from column x, the pixels out of the image are the identity */
+static const ia_uint8_t* ia_morphology_segment(ia_image_p src, ia_int32_t x, ia_int32_t y, ia_int32_t count, 
+											   const ia_uint8_t* identity, ia_uint8_t* segment)
+{
+	ia_int32_t size = ia_format_size(src->format) >> 3;
+	ia_int32_t lo = MAX(x, 0), hi = MIN(x + count, (ia_int32_t)src->width);
+	if (y < 0 || y >= src->height || lo >= hi)
+	{
+		return identity;
+	}
+	if (lo == x && hi == x + count)
+	{
+		return IA_IMAGE_ROW(src, y) + x * size;
+	}
+	memcpy(segment, identity, count * size);
+	memcpy(segment + (lo - x) * size, IA_IMAGE_ROW(src, y) + lo * size, (hi - lo) * size);
+	return segment;
+}
+
+static void ia_morphology_columns(ia_image_p src, ia_image_p dst, ia_int32_t k, ia_int32_t a, ia_int32_t shear, ia_bool_t is_max)
+{
+	ia_int32_t w      = src->width, h = src->height;
+	ia_int32_t m      = ((h + k - 1 + k - 1) / k) * k;
+	ia_int32_t depth  = ia_format_size(src->format), size = depth >> 3;
+	ia_int32_t strip  = IA_MORPHOLOGY_STRIP / size;
+	ia_int32_t first  = shear > 0 ? 1 - h : 0;
+	ia_int32_t last   = shear < 0 ? w + h - 2 : w - 1;
+	ia_int32_t strips = (last - first + strip) / strip;
+	ia_int32_t s;
+
+#pragma omp parallel
+	{
+		ia_uint8_t* forward  = (ia_uint8_t*)malloc(m * IA_MORPHOLOGY_STRIP);
+		ia_uint8_t* backward = (ia_uint8_t*)malloc(m * IA_MORPHOLOGY_STRIP);
+		ia_uint8_t* identity = (ia_uint8_t*)malloc(2 * IA_MORPHOLOGY_STRIP);
+		ia_uint8_t* segment  = identity + IA_MORPHOLOGY_STRIP;
+		memset(identity, is_max ? 0 : 0xFF, IA_MORPHOLOGY_STRIP);
+#pragma omp for schedule(static)
+		for (s=0; s<strips; s++)
+		{
+			ia_int32_t u     = first + s * strip;
+			ia_int32_t count = MIN(strip, last + 1 - u);
+			ia_int32_t y0 = 0, y1 = h, q, q0, q1;
+			if (shear)
+			{
+				/* the rows crossing the strip */
+				y0 = shear > 0 ? MAX(-(u + count - 1), 0) : MAX(u - (w - 1), 0);
+				y1 = shear > 0 ? MIN(w - u, h) : MIN(u + count, h);
+			}
+			/* whole blocks around the source rows of the output rows y0 to y1 */
+			q0 = (y0 / k) * k;
+			q1 = MIN(((y1 + k - 1 + k - 1) / k) * k, m);
+#define IA_MORPHOLOGY_SOURCE(q) ia_morphology_segment(src, u + shear * ((q) - a), (q) - a, count, identity, segment)
+			for (q=q0; q<q1; q++)
+			{
+				ia_uint8_t* f = forward + q * IA_MORPHOLOGY_STRIP;
+				if (q % k == 0)
+					memcpy(f, IA_MORPHOLOGY_SOURCE(q), count * size);
+				else
+					ia_morphology_rows(f, f - IA_MORPHOLOGY_STRIP, IA_MORPHOLOGY_SOURCE(q), count, depth, is_max);
+			}
+			for (q=q1 - 1; q>=q0; q--)
+			{
+				ia_uint8_t* b = backward + q * IA_MORPHOLOGY_STRIP;
+				if (q % k == k - 1)
+					memcpy(b, IA_MORPHOLOGY_SOURCE(q), count * size);
+				else
+					ia_morphology_rows(b, b + IA_MORPHOLOGY_STRIP, IA_MORPHOLOGY_SOURCE(q), count, depth, is_max);
+			}
+#undef IA_MORPHOLOGY_SOURCE
+			for (q=y0; q<y1; q++)
+			{
+				ia_int32_t x  = u + shear * q;
+				ia_int32_t lo = MAX(x, 0), hi = MIN(x + count, w);
+				if (lo < hi)
+				{
+					ia_morphology_rows(IA_IMAGE_ROW(dst, q) + lo * size, backward + q * IA_MORPHOLOGY_STRIP + (lo - x) * size, 
+									   forward + (q + k - 1) * IA_MORPHOLOGY_STRIP + (lo - x) * size, hi - lo, depth, is_max);
+				}
+			}
+		}
+		free(forward);
+		free(backward);
+		free(identity);
+	}
+}
+
+/*
+ * Dilation or erosion of 8 or 16-bit gray image by a rectangle or a 
+ * diagonal in constant time per pixel. The dilation takes the source 
+ * pixels at the center minus the element offsets and the erosion those 
+ * at the center plus the offsets
+ */
+static ia_image_p ia_morphology_extremum(ia_image_p image, ia_structure_p structure, ia_bool_t is_max)
+{
+	ia_int32_t w = image->width, h = image->height;
+	ia_int32_t sw = structure->width, sh = structure->height;
+	ia_int32_t i;
+	ia_image_p output = ia_image_new(w, h, image->format, IA_IMAGE_GRAY);
+	if (!output)
+	{
+		return NULL;
+	}
+
+	if (structure->shape == IA_STRUCTURE_RECT)
+	{
+		ia_image_p rows = image;
+		if (sw > 1)
+		{
+			/* the horizontal pass goes straight to output if there is no vertical */
+			rows = sh > 1 ? ia_image_new(w, h, image->format, IA_IMAGE_GRAY) : output;
+			if (!rows)
+			{
+				output->destroy(output);
+				return NULL;
+			}
+#pragma omp parallel
+			{
+				ia_uint16_t* buffer = (ia_uint16_t*)malloc(3 * (w + 2 * sw) * sizeof(ia_uint16_t));
+#pragma omp for schedule(static)
+				for (i=0; i<h; i++)
+				{
+					ia_morphology_line(image, rows, 0, i, 1, 0, w, sw, is_max ? sw - 1 - (sw >> 1) : (sw >> 1), is_max, buffer);
+				}
+				free(buffer);
+			}
+		}
+		if (sh > 1)
+		{
+			ia_morphology_columns(rows, output, sh, is_max ? sh - 1 - (sh >> 1) : (sh >> 1), 0, is_max);
+		}
+		else if (sw == 1)
+		{
+			memcpy(output->pixels.data, image->pixels.data, image->pixels.size);
+		}
+		if (rows != image && rows != output)
+		{
+			rows->destroy(rows);
+		}
+	}
+	else
+	{
+		/* the odd element is symmetric */
+		ia_morphology_columns(image, output, sw, sw >> 1, structure->shape == IA_STRUCTURE_DIAGONAL ? 1 : -1, is_max);
+	}
+	return output;
+}
+
+/*
+ * Packed IAT_BOOL morphology. A row is loaded into 64-bit words with 
+ * guard words on both sides holding the value of the pixels out of the 
+ * image, wide enough that every shift reading past the buffer would 
+ * read that value too. Each element row is a set of runs, a run of 
+ * length L is the OR or the AND of log2(L) doubling shifts, and the 
+ * rows of the element combine shifted image rows of these results.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IA_MORPHOLOGY_AVX2
+#include <immintrin.h>
+#define IA_TARGET_AVX2 __attribute__((target("avx2")))
+#define ia_cpu_has_avx2() __builtin_cpu_supports("avx2")
+#endif
+
+#ifdef IA_MORPHOLOGY_AVX2
+
+IA_TARGET_AVX2 static ia_int32_t ia_morphology_shift_avx2(ia_uint64_t* dst, const ia_uint64_t* a, const ia_uint64_t* b,
+														  ia_int32_t k, ia_int32_t end, ia_int32_t q, ia_int32_t r, ia_bool_t is_or)
+{
+	const __m128i left  = _mm_cvtsi32_si128(r);
+	const __m128i right = _mm_cvtsi32_si128(64 - r);
+	for (; k + 4 <= end; k+=4)
+	{
+		/* a count of 64 shifts everything out, so r = 0 needs no case */
+		__m256i v = _mm256_or_si256(_mm256_sll_epi64(_mm256_loadu_si256((const __m256i*)(b + k - q)), left),
+									_mm256_srl_epi64(_mm256_loadu_si256((const __m256i*)(b + k - q - 1)), right));
+		if (a)
+		{
+			__m256i u = _mm256_loadu_si256((const __m256i*)(a + k));
+			v = is_or ? _mm256_or_si256(u, v) : _mm256_and_si256(u, v);
+		}
+		_mm256_storeu_si256((__m256i*)(dst + k), v);
+	}
+	return k;
+}
+
+IA_TARGET_AVX2 static ia_int32_t ia_morphology_combine_avx2(ia_uint64_t* dst, const ia_uint64_t* a, ia_int32_t count, ia_bool_t is_or)
+{
+	ia_int32_t k;
+	for (k=0; k + 4 <= count; k+=4)
+	{
+		__m256i u = _mm256_loadu_si256((const __m256i*)(dst + k));
+		__m256i v = _mm256_loadu_si256((const __m256i*)(a + k));
+		_mm256_storeu_si256((__m256i*)(dst + k), is_or ? _mm256_or_si256(u, v) : _mm256_and_si256(u, v));
+	}
+	return k;
+}
+
+#endif /* IA_MORPHOLOGY_AVX2 */
+
+/* dst(x) = b(x - shift), combined with a(x) if given, the words out of b are outside */
+static void ia_morphology_shift(ia_uint64_t* dst, const ia_uint64_t* a, const ia_uint64_t* b, ia_int32_t total,
+								ia_int32_t shift, ia_bool_t is_or, ia_uint64_t outside)
+{
+	ia_int32_t q  = shift >= 0 ? shift >> 6 : -((63 - shift) >> 6);
+	ia_int32_t r  = shift - q * 64;
+	ia_int32_t lo = MIN(MAX(0, q + 1), total);
+	ia_int32_t hi = MIN(total, total + q);
+	ia_int32_t k;
+
+	for (k=0; k<lo; k++)
+	{
+		dst[k] = !a ? outside : is_or ? a[k] | outside : a[k] & outside;
+	}
+#ifdef IA_MORPHOLOGY_AVX2
+	if (k < hi && ia_cpu_has_avx2())
+	{
+		k = ia_morphology_shift_avx2(dst, a, b, k, hi, q, r, is_or);
+	}
+#endif
+	for (; k<hi; k++)
+	{
+		ia_uint64_t v = r ? (b[k - q] << r) | (b[k - q - 1] >> (64 - r)) : b[k - q];
+		dst[k] = !a ? v : is_or ? a[k] | v : a[k] & v;
+	}
+	for (; k<total; k++)
+	{
+		dst[k] = !a ? outside : is_or ? a[k] | outside : a[k] & outside;
+	}
+}
+
+/* dst = dst OR a or dst AND a */
+static void ia_morphology_combine(ia_uint64_t* dst, const ia_uint64_t* a, ia_int32_t count, ia_bool_t is_or)
+{
+	ia_int32_t k = 0;
+#ifdef IA_MORPHOLOGY_AVX2
+	if (ia_cpu_has_avx2())
+	{
+		k = ia_morphology_combine_avx2(dst, a, count, is_or);
+	}
+#endif
+	if (is_or)
+		for (; k<count; k++) dst[k] |= a[k];
+	else
+		for (; k<count; k++) dst[k] &= a[k];
+}
+
+/*
+ * ORs (dilation) or ANDs (erosion) the packed binary image, optionally 
+ * inverted, at x - offsets if reflect or x + offsets otherwise, with the 
+ * pixels out of the image taken as outside. Returns the result as height 
+ * rows of (width+63)/64 words
+ */
+static ia_uint64_t* ia_morphology_bits(ia_image_p image, ia_structure_p structure, ia_bool_t is_or, 
+									   ia_bool_t reflect, ia_bool_t inverse, ia_bool_t outside)
+{
+	ia_int32_t  w = image->width, h = image->height;
+	ia_int32_t  sw = structure->width, sh = structure->height;
+	ia_int32_t  w2 = sw >> 1, h2 = sh >> 1;
+	ia_int32_t  words = (w + 63) >> 6;
+	ia_int32_t  guard = (2 * sw + 63) / 64 + 1;
+	ia_int32_t  total = words + 2 * guard;
+	ia_int32_t  stride = (ia_int32_t)IA_IMAGE_STRIDE(image);
+	ia_uint64_t fill = outside ? ~(ia_uint64_t)0 : 0;
+	ia_uint64_t *rows, *result;
+	ia_int32_t  y;
+
+	rows   = (ia_uint64_t*)malloc((ia_uint32_t)MAX(structure->patterns, 1) * h * words * sizeof(ia_uint64_t));
+	result = (ia_uint64_t*)malloc((ia_uint32_t)h * words * sizeof(ia_uint64_t));
+	if (!rows || !result)
+	{
+		free(rows);
+		free(result);
+		return NULL;
+	}
+
+#pragma omp parallel
+	{
+		ia_uint64_t* line = (ia_uint64_t*)malloc(4 * total * sizeof(ia_uint64_t));
+		ia_uint64_t* acc  = line + total;
+		ia_uint64_t* run  = acc + total;
+		ia_uint64_t* next = run + total;
+
+#pragma omp for schedule(static)
+		for (y=0; y<h; y++)
+		{
+			ia_uint8_t* bytes = (ia_uint8_t*)(line + guard);
+			ia_int32_t  p, n, x, done = 0;
+			memset(line, (ia_uint8_t)fill, total * sizeof(ia_uint64_t));
+			memcpy(bytes, IA_IMAGE_ROW(image, y), stride);
+			if (inverse)
+			{
+				for (x=0; x<stride; x++)
+					bytes[x] = (ia_uint8_t)~bytes[x];
+			}
+			if (w & 7)
+			{
+				ia_uint8_t mask = (ia_uint8_t)((1 << (w & 7)) - 1);
+				bytes[stride - 1] = (ia_uint8_t)((bytes[stride - 1] & mask) | ((ia_uint8_t)fill & ~mask));
+			}
+
+			for (p=0; p<sh; p++)
+			{
+				if (structure->pattern[p] != done)
+				{
+					continue;
+				}
+				done++;
+				/* OR of the runs for dilation, AND for erosion */
+				memset(acc, is_or ? 0 : 0xFF, total * sizeof(ia_uint64_t));
+				for (n=0; n<structure->runs[p]; n++)
+				{
+					ia_int32_t start = structure->starts[p * sw + n], size = structure->lengths[p * sw + n], span;
+					/* align the run start, then double the run up to its length */
+					ia_morphology_shift(run, NULL, line, total, reflect ? start - w2 : w2 - start, is_or, fill);
+					for (span=1; span<size; span*=2)
 					{
-						ia_uint32_t color=image->get_pixel(image, l, k);
-						if (color)
-							output->set_pixel(output, l+j, k+i, color);
+						ia_int32_t   step = MIN(span, size - span);
+						ia_uint64_t* swap;
+						ia_morphology_shift(next, run, run, total, reflect ? step : -step, is_or, fill);
+						swap = run; run = next; next = swap;
 					}
+					ia_morphology_combine(acc, run, total, is_or);
+				}
+				memcpy(rows + ((ia_uint32_t)structure->pattern[p] * h + y) * words, acc + guard, words * sizeof(ia_uint64_t));
+			}
+		}
+		free(line);
+	}
+
+	/* the element rows combine the horizontal results of the image rows at y -+ offset */
+#pragma omp parallel for schedule(static)
+	for (y=0; y<h; y++)
+	{
+		ia_uint64_t* out = result + (ia_uint32_t)y * words;
+		ia_int32_t   k;
+		memset(out, is_or ? 0 : 0xFF, words * sizeof(ia_uint64_t));
+		for (k=0; k<sh; k++)
+		{
+			ia_int32_t source = reflect ? y - (k - h2) : y + (k - h2);
+			if (structure->pattern[k] < 0)
+			{
+				continue;
+			}
+			if (source >= 0 && source < h)
+			{
+				ia_morphology_combine(out, rows + ((ia_uint32_t)structure->pattern[k] * h + source) * words, words, is_or);
+			}
+			else if (outside == is_or)
+			{
+				/* the rows out of the image decide the result */
+				memset(out, (ia_uint8_t)fill, words * sizeof(ia_uint64_t));
+			}
+		}
+	}
+
+	free(rows);
+	return result;
+}
+
+/* stores packed rows of words into IAT_BOOL image keeping the padding bits clear */
+static void ia_morphology_bits_store(const ia_uint64_t* result, ia_image_p output)
+{
+	ia_int32_t y, words = (output->width + 63) >> 6;
+	ia_int32_t stride = (ia_int32_t)IA_IMAGE_STRIDE(output);
+	for (y=0; y<output->height; y++)
+	{
+		ia_uint8_t* row = IA_IMAGE_ROW(output, y);
+		memcpy(row, result + (ia_uint32_t)y * words, stride);
+		if (output->width & 7)
+		{
+			row[stride - 1] &= (ia_uint8_t)((1 << (output->width & 7)) - 1);
+		}
+	}
+}
+
+static ia_image_p ia_morphology_bits_image(ia_image_p image, ia_structure_p structure, ia_bool_t is_dilation)
+{
+	ia_image_p   output = ia_image_new(image->width, image->height, IAT_BOOL, IA_IMAGE_GRAY);
+	/* as the other formats, both read the center minus the offsets with the background out of the image */
+	ia_uint64_t* result = output ? ia_morphology_bits(image, structure, is_dilation, IA_TRUE, IA_FALSE, IA_FALSE) : NULL;
+	if (!result)
+	{
+		if (output) output->destroy(output);
+		return NULL;
+	}
+	ia_morphology_bits_store(result, output);
+	free(result);
+	if (!is_dilation)
+	{
+		/* the eroded pixel keeps its own color as in the other formats, so an unset center stays unset */
+		ia_int32_t x, y, stride = (ia_int32_t)IA_IMAGE_STRIDE(output);
+		for (y=0; y<output->height; y++)
+		{
+			ia_uint8_t*       row = IA_IMAGE_ROW(output, y);
+			const ia_uint8_t* src = IA_IMAGE_ROW(image, y);
+			for (x=0; x<stride; x++)
+				row[x] &= src[x];
+		}
+	}
 	return output;
 }
 
-ia_image_p ia_morphology_erosion (ia_image_p image, ia_image_p structure)
+/*
+ * next(x) = op(t(x), t(x - shift)) over count elements of size bytes, 
+ * the elements read before the start or past the end are the identity
+ */
+static void ia_morphology_double(ia_uint8_t* next, const ia_uint8_t* t, ia_int32_t count, ia_int32_t shift, 
+								 ia_int32_t depth, ia_bool_t is_max)
 {
-	ia_int32_t i, j, k, l, w2 = (structure->width >> 1), h2 = (structure->height >> 1);
-	ia_image_p output = ia_image_new(image->width, image->height, image->format, IA_IMAGE_GRAY);
-	output->fill(output, 0);
+	ia_int32_t size = depth >> 3;
+	if (shift > 0)
+	{
+		memcpy(next, t, shift * size);
+		ia_morphology_rows(next + shift * size, t + shift * size, t, count - shift, depth, is_max);
+	}
+	else
+	{
+		ia_morphology_rows(next, t, t - shift * size, count + shift, depth, is_max);
+		memcpy(next + (count + shift) * size, t + (count + shift) * size, -shift * size);
+	}
+}
 
-	for (k=0; k<image->height; k++)
-		for (l=0; l<image->width; l++)
+/*
+ * The horizontal results of a row for every pattern of the element, 
+ * pattern p goes to results + p*plane. A row is padded with the 
+ * identity, the maximum of a run of L pixels is made by log2(L) 
+ * doubling passes of SIMD maximums of shifted loads. The line buffer 
+ * has 3 rows of width + 2*(element width + 1) pixels
+ */
+static void ia_morphology_horizontal(ia_structure_p structure, const ia_uint8_t* row, ia_int32_t w, ia_int32_t depth, 
+									 ia_bool_t is_max, ia_uint8_t* results, ia_uint32_t plane, ia_uint8_t* line)
+{
+	ia_int32_t sw = structure->width, w2 = sw >> 1;
+	ia_int32_t size = depth >> 3, pad = sw + 1, total = w + 2 * pad;
+	ia_uint8_t fill = is_max ? 0 : 0xFF;
+	ia_uint8_t* work  = line + total * size;
+	ia_uint8_t* other = work + total * size;
+	ia_int32_t  i, p, n;
+
+	memset(line, fill, pad * size);
+	memcpy(line + pad * size, row, w * size);
+	memset(line + (pad + w) * size, fill, pad * size);
+
+	for (p=0, i=0; i<structure->height; i++)
+	{
+		ia_uint8_t* acc;
+		if (structure->pattern[i] != p)
 		{
-			for (i=-h2; i<((structure->height+1) >> 1); i++)
-				for (j=-w2; j<((structure->width+1) >> 1); j++)
-					if (structure->get_pixel(structure, w2+j, h2+i))
-							if (!image->get_pixel(image, l-j, k-i)) goto failed;
+			continue;
+		}
+		acc = results + p * plane;
+		p++;
+		memset(acc, fill, w * size);
+		for (n=0; n<structure->runs[i]; n++)
+		{
+			ia_int32_t start  = structure->starts[i * sw + n] - w2;
+			ia_int32_t length = structure->lengths[i * sw + n], step;
+			const ia_uint8_t* t = line;
+			ia_uint8_t* next = work;
+			for (step=1; step<length; step*=2)
+			{
+				ia_int32_t shift = MIN(step, length - step);
+				ia_morphology_double(next, t, total, is_max ? shift : -shift, depth, is_max);
+				t = next;
+				next = next == work ? other : work;
+			}
+			/* the maximum of x - start - [0, length) or the minimum of x + start + [0, length) */
+			ia_morphology_rows(acc, acc, t + (pad + (is_max ? -start : start)) * size, w, depth, is_max);
+		}
+	}
+}
+
+/*
+ * Flat dilation or erosion of 8 or 16-bit gray image by any element. 
+ * The element rows combine the horizontal results at y -+ offset. Every 
+ * row band keeps the horizontal results of the rows it needs
+ */
+static ia_image_p ia_morphology_flat(ia_image_p image, ia_structure_p structure, ia_bool_t is_max)
+{
+	ia_int32_t w = image->width, h = image->height;
+	ia_int32_t sw = structure->width, sh = structure->height, h2 = sh >> 1;
+	ia_int32_t depth = ia_format_size(image->format), size = depth >> 3;
+	ia_int32_t total = w + 2 * (sw + 1);
+	ia_int32_t band = MAX(64, 4 * sh), bands = (h + band - 1) / band;
+	ia_int32_t span = band + sh - 1;
+	ia_image_p output;
+	ia_int32_t b;
+
+	output = ia_image_new(w, h, image->format, IA_IMAGE_GRAY);
+	if (!output)
+	{
+		return NULL;
+	}
+
+#pragma omp parallel
+	{
+		ia_uint8_t* line   = (ia_uint8_t*)malloc(3 * total * size);
+		ia_uint8_t* buffer = (ia_uint8_t*)malloc((ia_uint32_t)MAX(structure->patterns, 1) * span * w * size);
+
+#pragma omp for schedule(dynamic)
+		for (b=0; b<bands; b++)
+		{
+			ia_int32_t y0 = b * band, y1 = MIN(y0 + band, h);
+			ia_int32_t first = is_max ? y0 - (sh - 1 - h2) : y0 - h2;
+			ia_int32_t y, i;
+
+			/* the horizontal results of the source rows of the band */
+			for (y=MAX(first, 0); y<=MIN(first + (y1 - y0) + sh - 2, h - 1); y++)
+			{
+				ia_morphology_horizontal(structure, IA_IMAGE_ROW(image, y), w, depth, is_max, 
+										 buffer + (ia_uint32_t)(y - first) * w * size, (ia_uint32_t)span * w * size, line);
+			}
+
+			for (y=y0; y<y1; y++)
+			{
+				ia_uint8_t* out = IA_IMAGE_ROW(output, y);
+				memset(out, is_max ? 0 : 0xFF, w * size);
+				for (i=0; i<sh; i++)
+				{
+					ia_int32_t source = is_max ? y - (i - h2) : y + (i - h2);
+					if (structure->pattern[i] >= 0 && source >= 0 && source < h)
+					{
+						ia_morphology_rows(out, out, buffer + ((ia_uint32_t)structure->pattern[i] * span + (source - first)) * w * size, 
+										   w, depth, is_max);
+					}
+				}
+			}
+		}
+		free(line);
+		free(buffer);
+	}
+
+	return output;
+}
+
+/*
+ * Streamed chain of flat dilations and erosions by one element. Every 
+ * stage keeps the horizontal results of its last sh input rows in a 
+ * ring, makes an output row as soon as the input rows it needs are in 
+ * and feeds it straight to the next stage, so there is no intermediate 
+ * image. The row bands are widened by the reach of the later stages
+ */
+typedef struct
+{
+	ia_bool_t   is_max;
+	ia_int32_t  lo, hi;       /* output row y needs the input rows y+lo to y+hi */
+	ia_int32_t  next;         /* next output row */
+	ia_int32_t  last;         /* output rows end */
+	ia_int32_t  end;          /* input rows end */
+	ia_uint8_t* ring;         /* patterns planes of sh rows of horizontal results */
+	ia_uint8_t* row;          /* output row */
+} ia_morphology_stage_t;
+
+typedef struct
+{
+	ia_structure_p         structure;
+	ia_int32_t             width, height, depth;
+	ia_int32_t             count;   /* stages */
+	ia_morphology_stage_t* stage;
+	ia_uint8_t*            line;    /* horizontal pass buffer */
+	ia_image_p             output;
+} ia_morphology_stream_t;
+
+static void ia_morphology_feed(ia_morphology_stream_t* stream, ia_int32_t s, ia_int32_t y, const ia_uint8_t* row)
+{
+	ia_morphology_stage_t* stage = stream->stage + s;
+	ia_structure_p structure = stream->structure;
+	ia_int32_t  w = stream->width, sh = structure->height, h2 = sh >> 1;
+	ia_int32_t  depth = stream->depth, size = depth >> 3;
+	ia_uint32_t plane = (ia_uint32_t)sh * w * size;
+
+	ia_morphology_horizontal(structure, row, w, depth, stage->is_max, stage->ring + (ia_uint32_t)(y % sh) * w * size, plane, stream->line);
+
+	/* the output rows with all their input rows in */
+	while (stage->next < stage->last && MIN(stage->next + stage->hi, stage->end - 1) <= y)
+	{
+		ia_int32_t  i, next = stage->next++;
+		ia_uint8_t* out = s == stream->count - 1 ? IA_IMAGE_ROW(stream->output, next) : stage->row;
+		memset(out, stage->is_max ? 0 : 0xFF, w * size);
+		for (i=0; i<sh; i++)
+		{
+			ia_int32_t source = stage->is_max ? next - (i - h2) : next + (i - h2);
+			if (structure->pattern[i] >= 0 && source >= 0 && source < stream->height)
+			{
+				ia_morphology_rows(out, out, stage->ring + structure->pattern[i] * plane + (ia_uint32_t)(source % sh) * w * size, 
+								   w, depth, stage->is_max);
+			}
+		}
+		if (s < stream->count - 1)
+		{
+			ia_morphology_feed(stream, s + 1, next, out);
+		}
+	}
+}
+
+/* n erosions then n dilations for opening, the other way around for closing */
+static ia_image_p ia_morphology_stream(ia_image_p image, ia_structure_p structure, ia_int32_t n, ia_bool_t is_opening)
+{
+	ia_int32_t  w = image->width, h = image->height;
+	ia_int32_t  sw = structure->width, sh = structure->height, h2 = sh >> 1;
+	ia_int32_t  depth = ia_format_size(image->format), size = depth >> 3;
+	ia_int32_t  count = 2 * n, reach = count * (sh - 1);
+	ia_int32_t  band = MAX(256, 8 * reach), bands = (h + band - 1) / band;
+	ia_uint32_t ring = (ia_uint32_t)MAX(structure->patterns, 1) * sh * w * size;
+	ia_image_p  output;
+	ia_int32_t  b;
+
+	output = ia_image_new(w, h, image->format, IA_IMAGE_GRAY);
+	if (!output)
+	{
+		return NULL;
+	}
+
+#pragma omp parallel
+	{
+		ia_morphology_stream_t stream;
+		ia_uint8_t* buffer;
+		ia_int32_t  s;
+		stream.structure = structure;
+		stream.width     = w;
+		stream.height    = h;
+		stream.depth     = depth;
+		stream.count     = count;
+		stream.output    = output;
+		stream.stage     = (ia_morphology_stage_t*)malloc(count * sizeof(ia_morphology_stage_t));
+		stream.line      = (ia_uint8_t*)malloc(3 * (w + 2 * (sw + 1)) * size);
+		buffer           = (ia_uint8_t*)malloc(count * (ring + w * size));
+		for (s=0; s<count; s++)
+		{
+			ia_morphology_stage_t* stage = stream.stage + s;
+			stage->is_max = (ia_bool_t)((s < n) != is_opening);
+			stage->lo     = stage->is_max ? -(sh - 1 - h2) : -h2;
+			stage->hi     = stage->is_max ? h2 : sh - 1 - h2;
+			stage->ring   = buffer + s * (ring + w * size);
+			stage->row    = stage->ring + ring;
+		}
+
+#pragma omp for schedule(dynamic)
+		for (b=0; b<bands; b++)
+		{
+			ia_int32_t first = b * band, last = MIN(first + band, h), y;
+			/* every stage makes the input rows of the next one */
+			for (s=count - 1; s>=0; s--)
+			{
+				ia_morphology_stage_t* stage = stream.stage + s;
+				stage->next = first;
+				stage->last = last;
+				stage->end  = MIN(last + stage->hi, h);
+				first = MAX(first + stage->lo, 0);
+				last  = stage->end;
+			}
+			for (y=first; y<last; y++)
+			{
+				ia_morphology_feed(&stream, 0, y, IA_IMAGE_ROW(image, y));
+			}
+		}
+		free(stream.stage);
+		free(stream.line);
+		free(buffer);
+	}
+
+	return output;
+}
+
+/* dst = a - b, saturated to 0, dst may be a or b */
+static void ia_morphology_difference(ia_image_p dst, ia_image_p a, ia_image_p b)
+{
+	ia_int32_t y;
+	ia_bool_t  is_signed = ia_format_signed(a->format);
+#pragma omp parallel for schedule(static)
+	for (y=0; y<a->height; y++)
+	{
+		ia_uint8_t*       d = IA_IMAGE_ROW(dst, y);
+		const ia_uint8_t* s = IA_IMAGE_ROW(a, y);
+		const ia_uint8_t* t = IA_IMAGE_ROW(b, y);
+		ia_int32_t x = 0, bytes = (ia_int32_t)IA_IMAGE_STRIDE(a);
+		if (a->format == IAT_BOOL)
+		{
+			for (; x<bytes; x++)
+				d[x] = s[x] & ~t[x];
+		}
+		else if (a->is_gray && (a->format == IAT_UINT_8 || a->format == IAT_UINT_16))
+		{
+#ifdef __SSE2__
+			for (; x + 16 <= bytes; x+=16)
+			{
+				__m128i u = _mm_loadu_si128((const __m128i*)(s + x));
+				__m128i v = _mm_loadu_si128((const __m128i*)(t + x));
+				_mm_storeu_si128((__m128i*)(d + x), a->format == IAT_UINT_8 ? _mm_subs_epu8(u, v) : _mm_subs_epu16(u, v));
+			}
+#endif
+			if (a->format == IAT_UINT_8)
+				for (; x<bytes; x++)
+					d[x] = s[x] > t[x] ? s[x] - t[x] : 0;
+			else
+				for (x>>=1; x<a->width; x++)
+					((ia_uint16_t*)d)[x] = ((const ia_uint16_t*)s)[x] > ((const ia_uint16_t*)t)[x] ? 
+										   ((const ia_uint16_t*)s)[x] - ((const ia_uint16_t*)t)[x] : 0;
+		}
+		else
+		{
+			for (; x<a->width; x++)
+			{
+				ia_uint32_t u = a->get_pixel(a, x, y), v = b->get_pixel(b, x, y);
+				ia_bool_t above = is_signed ? (ia_int32_t)u > (ia_int32_t)v : u > v;
+				dst->set_pixel(dst, x, y, above ? u - v : 0);
+			}
+		}
+	}
+}
+
+/* true if the image has the gray 8 or 16-bit paths */
+static ia_bool_t ia_morphology_is_flat(ia_image_p image)
+{
+	return (ia_bool_t)(image->is_gray && (image->format == IAT_UINT_8 || image->format == IAT_UINT_16));
+}
+
+/*
+ * Successive dilations or erosions by the decomposition elements. The 
+ * image is padded with the identity by the element radius, so the 
+ * borders come out as with the whole element
+ */
+static ia_image_p ia_morphology_factors(ia_image_p image, ia_structure_p structure, ia_bool_t is_max)
+{
+	ia_int32_t w = image->width, h = image->height;
+	ia_int32_t w2 = structure->width >> 1, h2 = structure->height >> 1;
+	ia_int32_t size = ia_format_size(image->format) >> 3;
+	ia_image_p padded, output = NULL;
+	ia_int32_t i, y;
+
+	padded = ia_image_new(w + 2 * w2, h + 2 * h2, image->format, IA_IMAGE_GRAY);
+	if (!padded)
+	{
+		return NULL;
+	}
+	memset(padded->pixels.data, is_max ? 0 : 0xFF, padded->pixels.size);
+	for (y=0; y<h; y++)
+	{
+		memcpy(IA_IMAGE_ROW(padded, y + h2) + w2 * size, IA_IMAGE_ROW(image, y), w * size);
+	}
+
+	for (i=0; i<structure->factors && padded; i++)
+	{
+		ia_image_p next = is_max ? ia_morphology_dilation_se(padded, structure->factor[i]) : 
+								   ia_morphology_erosion_se(padded, structure->factor[i]);
+		padded->destroy(padded);
+		padded = next;
+	}
+
+	if (padded)
+	{
+		output = ia_image_new(w, h, image->format, IA_IMAGE_GRAY);
+		if (output)
+		{
+			for (y=0; y<h; y++)
+			{
+				memcpy(IA_IMAGE_ROW(output, y), IA_IMAGE_ROW(padded, y + h2) + w2 * size, w * size);
+			}
+		}
+		padded->destroy(padded);
+	}
+	return output;
+}
+
+/* true if the runs of the element are the cheapest path for gray images */
+static ia_bool_t ia_morphology_by_runs(ia_structure_p structure)
+{
+	switch (structure->shape)
+	{
+	case IA_STRUCTURE_RECT:
+	case IA_STRUCTURE_DIAGONAL:
+	case IA_STRUCTURE_ANTIDIAGONAL:
+		return (ia_bool_t)(ia_structure_runs_cost(structure) <= ia_structure_cost(structure));
+	case IA_STRUCTURE_DIAMOND:
+	case IA_STRUCTURE_OCTAGON:
+		/* decomposed only where that is cheaper */
+		return IA_FALSE;
+	default:
+		return IA_TRUE;
+	}
+}
+
+/* compiles the element, applies op and releases the element */
+#define IA_MORPHOLOGY_COMPILED(op, image, structure) \
+	ia_structure_p se = ia_structure_new(structure); \
+	ia_image_p output = NULL; \
+	if (se) \
+	{ \
+		output = op(image, se); \
+		se->destroy(se); \
+	} \
+	return output;
+
+ia_image_p ia_morphology_dilation_se(ia_image_p image, ia_structure_p structure)
+{
+	ia_int32_t i, k, l;
+	ia_image_p output;
+	if (ia_morphology_is_flat(image))
+	{
+		if (ia_morphology_by_runs(structure))
+		{
+			return ia_morphology_flat(image, structure, IA_TRUE);
+		}
+		if (structure->factors)
+		{
+			return ia_morphology_factors(image, structure, IA_TRUE);
+		}
+		return ia_morphology_extremum(image, structure, IA_TRUE);
+	}
+	if (image->format == IAT_BOOL)
+	{
+		return ia_morphology_bits_image(image, structure, IA_TRUE);
+	}
+
+	output = ia_image_new(image->width, image->height, image->format, IA_IMAGE_GRAY);
+
+	for (i=0; i<structure->count; i++)
+		for (k=0; k<image->height; k++)
+			for (l=0; l<image->width; l++)
+			{
+				ia_uint32_t color=image->get_pixel(image, l, k);
+				if (color)
+					output->set_pixel(output, l+structure->dx[i], k+structure->dy[i], color);
+			}
+	return output;
+}
+
+ia_image_p ia_morphology_erosion_se(ia_image_p image, ia_structure_p structure)
+{
+	ia_int32_t i, k, l, w = image->width, h = image->height;
+	ia_int32_t w2 = (structure->width >> 1), h2 = (structure->height >> 1);
+	ia_int32_t size = ia_format_size(image->format) >> 3, s;
+	ia_bool_t  direct = (ia_bool_t)(image->format != IAT_FLOAT && image->format != IAT_DOUBLE);
+	const ia_int32_t* offset;
+	ia_image_p output;
+	if (ia_morphology_is_flat(image))
+	{
+		if (ia_morphology_by_runs(structure))
+		{
+			return ia_morphology_flat(image, structure, IA_FALSE);
+		}
+		if (structure->factors)
+		{
+			return ia_morphology_factors(image, structure, IA_FALSE);
+		}
+		return ia_morphology_extremum(image, structure, IA_FALSE);
+	}
+	if (image->format == IAT_BOOL)
+	{
+		return ia_morphology_bits_image(image, structure, IA_FALSE);
+	}
+
+	output = ia_image_new(w, h, image->format, IA_IMAGE_GRAY);
+	offset = structure->offsets(structure, w);
+
+	for (k=0; k<h; k++)
+		for (l=0; l<w; l++)
+		{
+			if (direct && l >= structure->width - 1 - w2 && l < w - w2 && k >= structure->height - 1 - h2 && k < h - h2)
+			{
+				/* the whole element is in the image, an integer color is nonzero if any byte is */
+				const ia_uint8_t* p = (const ia_uint8_t*)image->pixels.data + ((ia_uint32_t)k * w + l) * size;
+				for (i=0; i<structure->count; i++)
+				{
+					const ia_uint8_t* q = p - offset[i] * size;
+					for (s=0; s<size && !q[s]; s++);
+					if (s == size) goto failed;
+				}
+			}
+			else
+			{
+				for (i=0; i<structure->count; i++)
+					if (!image->get_pixel(image, l-structure->dx[i], k-structure->dy[i])) goto failed;
+			}
 
 			output->set_pixel(output, l, k, image->get_pixel(image, l, k));
 failed:;
@@ -51,18 +1329,185 @@ failed:;
 	return output;
 }
 
+/* n erosions then n dilations for opening, the other way around for closing */
+static ia_image_p ia_morphology_chain(ia_image_p image, ia_structure_p structure, ia_int32_t n, ia_bool_t is_opening)
+{
+	ia_image_p current = image, next;
+	ia_int32_t i;
+	if (n < 1)
+	{
+		return image->copy(image);
+	}
+	if (ia_morphology_is_flat(image) && ia_morphology_by_runs(structure))
+	{
+		return ia_morphology_stream(image, structure, n, is_opening);
+	}
+	for (i=0; i<2 * n && current; i++)
+	{
+		next = (i < n) == is_opening ? ia_morphology_erosion_se(current, structure) : 
+									   ia_morphology_dilation_se(current, structure);
+		if (current != image)
+		{
+			current->destroy(current);
+		}
+		current = next;
+	}
+	return current;
+}
+
+ia_image_p ia_morphology_opening_se(ia_image_p image, ia_structure_p structure)
+{
+	return ia_morphology_chain(image, structure, 1, IA_TRUE);
+}
+
+ia_image_p ia_morphology_closing_se(ia_image_p image, ia_structure_p structure)
+{
+	return ia_morphology_chain(image, structure, 1, IA_FALSE);
+}
+
+ia_image_p ia_morphology_opening_n(ia_image_p image, ia_structure_p structure, ia_int32_t n)
+{
+	return ia_morphology_chain(image, structure, n, IA_TRUE);
+}
+
+ia_image_p ia_morphology_closing_n(ia_image_p image, ia_structure_p structure, ia_int32_t n)
+{
+	return ia_morphology_chain(image, structure, n, IA_FALSE);
+}
+
+ia_image_p ia_morphology_top_hat_se(ia_image_p image, ia_structure_p structure)
+{
+	ia_image_p output = ia_morphology_opening_se(image, structure);
+	if (output)
+	{
+		ia_morphology_difference(output, image, output);
+	}
+	return output;
+}
+
+ia_image_p ia_morphology_black_hat_se(ia_image_p image, ia_structure_p structure)
+{
+	ia_image_p output = ia_morphology_closing_se(image, structure);
+	if (output)
+	{
+		ia_morphology_difference(output, output, image);
+	}
+	return output;
+}
+
+ia_image_p ia_morphology_gradient_se(ia_image_p image, ia_structure_p structure)
+{
+	ia_image_p output  = ia_morphology_dilation_se(image, structure);
+	ia_image_p erosion = ia_morphology_erosion_se(image, structure);
+	if (output && erosion)
+	{
+		ia_morphology_difference(output, output, erosion);
+	}
+	else if (output)
+	{
+		output->destroy(output);
+		output = NULL;
+	}
+	if (erosion)
+	{
+		erosion->destroy(erosion);
+	}
+	return output;
+}
+
+ia_image_p ia_morphology_hit_or_miss_se(ia_image_p image, ia_structure_p hit, ia_structure_p miss)
+{
+	ia_image_p   bits = image, output;
+	ia_uint64_t *fit, *miss_fit = NULL;
+	ia_int32_t   i, j;
+
+	if (image->format != IAT_BOOL)
+	{
+		/* any nonzero color is foreground */
+		bits = ia_image_new(image->width, image->height, IAT_BOOL, IA_IMAGE_GRAY);
+		for (i=0; i<image->height; i++)
+			for (j=0; j<image->width; j++)
+				bits->set_pixel(bits, j, i, image->get_pixel(image, j, i) != 0);
+	}
+
+	/* the foreground must cover the hit pixels and the background the miss pixels */
+	output = ia_image_new(image->width, image->height, IAT_BOOL, IA_IMAGE_GRAY);
+	fit = ia_morphology_bits(bits, hit, IA_FALSE, IA_FALSE, IA_FALSE, IA_FALSE);
+	if (miss)
+	{
+		miss_fit = ia_morphology_bits(bits, miss, IA_FALSE, IA_FALSE, IA_TRUE, IA_TRUE);
+	}
+
+	if (output && fit && (miss_fit || !miss))
+	{
+		ia_int32_t k, count = image->height * ((image->width + 63) >> 6);
+		if (miss_fit)
+		{
+			for (k=0; k<count; k++)
+				fit[k] &= miss_fit[k];
+		}
+		ia_morphology_bits_store(fit, output);
+	}
+	else if (output)
+	{
+		output->destroy(output);
+		output = NULL;
+	}
+
+	free(fit);
+	free(miss_fit);
+	if (bits != image)
+	{
+		bits->destroy(bits);
+	}
+	return output;
+}
+
+ia_image_p ia_morphology_dilation(ia_image_p image, ia_image_p structure)
+{
+	IA_MORPHOLOGY_COMPILED(ia_morphology_dilation_se, image, structure)
+}
+
+ia_image_p ia_morphology_erosion(ia_image_p image, ia_image_p structure)
+{
+	IA_MORPHOLOGY_COMPILED(ia_morphology_erosion_se, image, structure)
+}
+
 ia_image_p ia_morphology_opening(ia_image_p image, ia_image_p structure)
 {
-	ia_image_p erosion=ia_morphology_erosion(image, structure);
-	ia_image_p dilation=ia_morphology_dilation(erosion, structure);
-	erosion->destroy(erosion);
-	return dilation;
+	IA_MORPHOLOGY_COMPILED(ia_morphology_opening_se, image, structure)
 }
 
 ia_image_p ia_morphology_closing(ia_image_p image, ia_image_p structure)
 {
-	ia_image_p dilation=ia_morphology_dilation(image, structure);
-	ia_image_p erosion=ia_morphology_erosion(dilation, structure);
-	dilation->destroy(dilation);
-	return erosion;
+	IA_MORPHOLOGY_COMPILED(ia_morphology_closing_se, image, structure)
+}
+
+ia_image_p ia_morphology_top_hat(ia_image_p image, ia_image_p structure)
+{
+	IA_MORPHOLOGY_COMPILED(ia_morphology_top_hat_se, image, structure)
+}
+
+ia_image_p ia_morphology_black_hat(ia_image_p image, ia_image_p structure)
+{
+	IA_MORPHOLOGY_COMPILED(ia_morphology_black_hat_se, image, structure)
+}
+
+ia_image_p ia_morphology_gradient(ia_image_p image, ia_image_p structure)
+{
+	IA_MORPHOLOGY_COMPILED(ia_morphology_gradient_se, image, structure)
+}
+
+ia_image_p ia_morphology_hit_or_miss(ia_image_p image, ia_image_p hit, ia_image_p miss)
+{
+	ia_structure_p hit_se = ia_structure_new(hit);
+	ia_structure_p miss_se = miss ? ia_structure_new(miss) : NULL;
+	ia_image_p output = NULL;
+	if (hit_se && (miss_se || !miss))
+	{
+		output = ia_morphology_hit_or_miss_se(image, hit_se, miss_se);
+	}
+	if (hit_se) hit_se->destroy(hit_se);
+	if (miss_se) miss_se->destroy(miss_se);
+	return output;
 }
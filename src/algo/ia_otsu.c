@@ -13,157 +13,254 @@
 #include <math.h>
 #include <ia/algo/ia_otsu.h>
 
-/* 
- * Determines a threshold in a histogram
- * 1 - success, < 0  - error
+/*
+ * The criterion of K thresholds is the sum of mju^2/omega over the K+1 
+ * classes. With best[k][b] the maximum over the first k classes covering 
+ * the levels [0, b), best[k][b] = max best[k-1][a] + class(a, b) over a, 
+ * and the maximizing a does not decrease with b, so each k is searched 
+ * by divide and conquer in O(L log L) instead of O(L^K)
  */
-ia_int32_t ia_otsu(ia_signal_p histogram, 
-				   ia_uint32_t* treshold, 
-				   ia_uint32_t* mean,
-				   ia_uint32_t* meanblack,
-				   ia_uint32_t* meanwhite,
-				   ia_double_t* areablack,
-				   ia_double_t* areawhite,
-				   ia_double_t* maxcriterion)
+typedef struct
+{
+	const ia_uint64_t* omega;  /* omega[i] - sum of bins [0, i)      */
+	const ia_uint64_t* mju;    /* mju[i]   - sum of t*bins [0, i)    */
+	const ia_double_t* prev;   /* best of k-1 classes                */
+	ia_double_t*       cur;    /* best of k classes                  */
+	ia_int32_t*        from;   /* the start of the k-th class at b   */
+} ia_otsu_n_step_t;
+
+static ia_double_t ia_otsu_class(const ia_uint64_t* omega, const ia_uint64_t* mju, ia_int32_t a, ia_int32_t b)
 {
-	ia_uint32_t NN; 
-	ia_double_t NN_1;
-	ia_int32_t *Omega;
-	ia_int32_t *Mju;
-	ia_int32_t i;
-	ia_double_t muT;
-	ia_int32_t opti_1, omg_1, opti_omg1; ia_double_t mu_1, opti_mu1;
-	ia_int32_t opti_2, omg_2, opti_omg2; ia_double_t mu_2, opti_mu2;
-	ia_double_t sigma, sigma_1, sigma_2, sigmaMax = -1.0;
-	ia_int32_t t, t1;
+	ia_uint64_t omg = omega[b] - omega[a];
+	ia_double_t mu;
+	if (omg == 0)
+	{
+		return 0.0;
+	}
+	mu = (ia_double_t)(mju[b] - mju[a]);
+	return mu*mu/(ia_double_t)omg;
+}
 
-	/* sum all histo values */
-	NN = 0;
-	for (t=0; t < histogram->length; t++) 
-		NN += histogram->get_pixel(histogram, t);
+static void ia_otsu_n_search(ia_otsu_n_step_t* step, ia_int32_t lo, ia_int32_t hi, ia_int32_t from_lo, ia_int32_t from_hi)
+{
+	ia_int32_t b = (lo + hi) >> 1;
+	ia_int32_t a, last = MIN(from_hi, b - 1), opti = from_lo;
+	ia_double_t sigma, sigmaMax = -1.0;
 
-	if ( NN == 0L) 
+	for (a = from_lo; a <= last; a++)
 	{
-		/* input histo is empty */
-		return (-1);
+		sigma = step->prev[a] + ia_otsu_class(step->omega, step->mju, a, b);
+		if (sigmaMax < sigma)
+		{
+			opti = a;
+			sigmaMax = sigma;
+		}
 	}
-	else
+	step->cur[b]  = sigmaMax;
+	step->from[b] = opti;
+
+	if (lo < b)
+		ia_otsu_n_search(step, lo, b - 1, from_lo, opti);
+	if (b < hi)
+		ia_otsu_n_search(step, b + 1, hi, opti, from_hi);
+}
+
+/* 
+ * Determines count thresholds in a histogram
+ * 1 - success, < 0  - error
+ */
+ia_int32_t ia_otsu_n(ia_signal_p histogram, 
+					 ia_uint32_t count,
+					 ia_uint32_t* tresholds, 
+					 ia_uint32_t* mean,
+					 ia_uint32_t* means,
+					 ia_double_t* areas,
+					 ia_double_t* maxcriterion)
+{
+	ia_int32_t L = histogram->length, K = (ia_int32_t)count;
+	ia_uint64_t *omega, *mju;
+	ia_double_t *best;
+	ia_int32_t  *from;
+	ia_otsu_n_step_t step;
+	ia_double_t NN_1, muT;
+	ia_int32_t i, k, b;
+
+	if (K < 1 || K >= L)
 	{
-		NN_1 = 1./(double)NN;
+		/* not enough levels for the classes */
+		return (-3);
 	}
 
-	Omega = (ia_int32_t*)malloc(histogram->length * sizeof(ia_int32_t));
-	if (!Omega)
+	omega = (ia_uint64_t*)malloc(2 * (L + 1) * sizeof(ia_uint64_t));
+	best  = (ia_double_t*)malloc(2 * (L + 1) * sizeof(ia_double_t));
+	from  = (ia_int32_t*)malloc((size_t)(K + 2) * (L + 1) * sizeof(ia_int32_t));
+	if (!omega || !best || !from)
 	{
 		/* not enough memory */
+		free(omega);
+		free(best);
+		free(from);
 		return (-2);
 	}
+	mju = omega + L + 1;
 
-	Omega[0] = histogram->get_pixel(histogram, 0);
-
-	/* probability accummulation */
-	for (i = 1; i < histogram->length; i++) 
-		Omega[i] = Omega[i-1] + histogram->get_pixel(histogram, i);
+	/* probability and mean value accummulation */
+	omega[0] = mju[0] = 0;
+	for (i = 0; i < L; i++)
+	{
+		ia_uint32_t h = histogram->get_pixel(histogram, i);
+		omega[i + 1] = omega[i] + h;
+		mju[i + 1]   = mju[i] + (ia_uint64_t)i * h;
+	}
 
-	Mju = (ia_int32_t*)malloc(histogram->length*sizeof(ia_int32_t));
-	if (!Mju)
+	if (omega[L] == 0)
 	{
-		/* not enough memory */
-		free( (void*)Omega );
-		return (-2);
+		/* input histo is empty */
+		free(omega);
+		free(best);
+		free(from);
+		return (-1);
 	}
+	NN_1 = 1./(ia_double_t)omega[L];
+
+	/* the k-th class ends at b, leaving a level for each next class */
+	step.omega = omega;
+	step.mju   = mju;
+	step.prev  = best;
+	step.cur   = best + L + 1;
+	for (b = 1; b <= L - K; b++)
+	{
+		best[b] = ia_otsu_class(omega, mju, 0, b);
+	}
+	for (k = 2; k <= K; k++)
+	{
+		ia_int32_t last = L - 1 - (K - k);
+		step.from = from + (size_t)k * (L + 1);
+		ia_otsu_n_search(&step, k, last, k - 1, last - 1);
+		step.prev = step.cur;
+		step.cur  = (ia_double_t*)(step.prev == best ? best + L + 1 : best);
+	}
+	/* the last class always ends at L */
+	step.from = from + (size_t)(K + 1) * (L + 1);
+	ia_otsu_n_search(&step, L, L, K, L - 1);
 
-	/* mean value accummulation */
-	Mju[0] = 0;
-	for (i = 1; i < histogram->length; i++) 
-		Mju[i] = Mju[i-1] + i*histogram->get_pixel(histogram, i);
+	/* return results */
+	b = L;
+	for (k = K + 1; k >= 2; k--)
+	{
+		b = from[(size_t)k * (L + 1) + b];
+		tresholds[k - 2] = b - 1;
+	}
 
-	/* common mean value */
-	muT = Mju[histogram->length-1];
+	muT = (ia_double_t)mju[L] * NN_1;
+	if (mean)
+	{
+		*mean = (int)floor(muT+0.5);
+	}
 
-	 /* Start thresholding (t1: 0 -:- histosize-2) */
-	for (t1 = 0; t1 < histogram->length-1; t1++)
+	for (k = 0; k <= K && (means || areas); k++)
 	{
-		omg_1 = Omega[t1];
-		if (omg_1 > 0) 
+		ia_int32_t a = k > 0 ? (ia_int32_t)tresholds[k - 1] + 1 : 0;
+		ia_int32_t e = k < K ? (ia_int32_t)tresholds[k] + 1 : L;
+		ia_uint64_t omg = omega[e] - omega[a];
+		if (means)
 		{
-			/* Mju[0] = Mju[-1] = 0.0 */
-			mu_1 = (ia_double_t)Mju[t1];
-			sigma_1 = mu_1*mu_1/(ia_double_t)omg_1; 
-		}
-		else    
-		{ 
-			omg_1 = 0; 
-			mu_1 = sigma_1 = 0.0; 
-		} /* Omega[0 -:- t1] == 0.0 */
-
-		omg_2 = Omega[histogram->length-1] - Omega[t1];
-		if (omg_2 > 0) 
-		{ 
-			mu_2 = (ia_double_t)(Mju[histogram->length-1] - Mju[t1]);
-			sigma_2 = mu_2*mu_2/(ia_double_t)omg_2; 
+			if (omg > 0) 
+				means[k] = (int)floor((ia_double_t)(mju[e] - mju[a])/(double)omg + 0.5); 
+			else 
+				means[k] = 0;
 		}
-		else
-		{ 
-			omg_2 = 0; 
-			mu_2 = sigma_2 = 0.0; 
-		} /* Omega[t1+1 -:- histosize-1] == 0.0 */
-
-		sigma = sigma_1 + sigma_2;
-
-		if (sigmaMax < sigma)
-		{ 
-			opti_1 = t1;    
-			opti_mu1 = mu_1; 
-			opti_omg1 = omg_1;
-			opti_2 = histogram->length-1;
-			opti_mu2 = mu_2; 
-			opti_omg2 = omg_2;
-			sigmaMax = sigma;
+		if (areas)
+		{
+			areas[k] = omg*NN_1;
 		}
 	}
-	free( (void*)Mju );
-	free( (void*)Omega );
 
-	/* return results */
-	muT *= NN_1;
-	*treshold = opti_1; 
-	if (mean)
+	if (maxcriterion)
 	{
-		*mean = (int)floor(muT+0.5);
+		*maxcriterion = step.cur[L]*NN_1 - muT*muT; /* to Otsu origi criterion */
 	}
 
-	if (meanblack)
+	free(omega);
+	free(best);
+	free(from);
+	return (1);
+}
+
+/* 
+ * Determines a threshold in a histogram
+ * 1 - success, < 0  - error
+ */
+ia_int32_t ia_otsu(ia_signal_p histogram, 
+				   ia_uint32_t* treshold, 
+				   ia_uint32_t* mean,
+				   ia_uint32_t* meanblack,
+				   ia_uint32_t* meanwhite,
+				   ia_double_t* areablack,
+				   ia_double_t* areawhite,
+				   ia_double_t* maxcriterion)
+{
+	ia_uint32_t means[2];
+	ia_double_t areas[2];
+	ia_int32_t result = ia_otsu_n(histogram, 1, treshold, mean, means, areas, maxcriterion);
+	if (result > 0)
 	{
-		if (opti_omg1 > 0) 
-			*meanblack = (int)floor(opti_mu1/(double)opti_omg1 + 0.5); 
-		else 
-			*meanblack = 0;
+		if (meanblack) *meanblack = means[0];
+		if (meanwhite) *meanwhite = means[1];
+		if (areablack) *areablack = areas[0];
+		if (areawhite) *areawhite = areas[1];
 	}
+	return result;
+}
+
+/* 
+ * Determines the ia_otsu threshold in a histogram given as array of 
+ * bins, without allocating memory. The criterion values are the same 
+ * as in ia_otsu, so ties resolve to the same threshold
+ * 1 - success, < 0  - error
+ */
+ia_int32_t ia_otsu_bins(const ia_uint32_t* bins, 
+						ia_uint32_t length, 
+						ia_uint32_t* treshold, 
+						ia_double_t* maxcriterion)
+{
+	ia_uint64_t NN = 0, MT = 0, omg_1 = 0, mju_1 = 0;
+	ia_double_t sigma, sigmaMax = -1.0;
+	ia_uint32_t t;
 
-	if (meanwhite)
+	for (t=0; t < length; t++)
 	{
-		if (opti_omg2 > 0) 
-			*meanwhite = (int)floor(opti_mu2/(double)opti_omg2 + 0.5); 
-		else 
-			*meanwhite = 0;
+		NN += bins[t];
+		MT += (ia_uint64_t)t * bins[t];
 	}
-	
-	if (areablack)
+
+	if (NN == 0)
 	{
-		*areablack = opti_omg1*NN_1;
+		/* input histo is empty */
+		return (-1);
 	}
 
-	if (areawhite)
+	*treshold = 0;
+	for (t=0; t+1 < length; t++)
 	{
-		*areawhite = opti_omg2*NN_1;
+		ia_double_t mu_1, mu_2;
+		omg_1 += bins[t];
+		mju_1 += (ia_uint64_t)t * bins[t];
+		mu_1 = (ia_double_t)mju_1;
+		mu_2 = (ia_double_t)(MT - mju_1);
+		sigma = (omg_1 > 0 ? mu_1*mu_1/(ia_double_t)omg_1 : 0.0) 
+		      + (NN - omg_1 > 0 ? mu_2*mu_2/(ia_double_t)(NN - omg_1) : 0.0);
+		if (sigmaMax < sigma)
+		{
+			*treshold = t;
+			sigmaMax = sigma;
+		}
 	}
 
 	if (maxcriterion)
 	{
-		sigmaMax *= NN_1; 
-		sigmaMax -= muT*muT; /* to Otsu origi criterion */
-		*maxcriterion = sigmaMax;
+		ia_double_t muT = (ia_double_t)MT / (ia_double_t)NN;
+		*maxcriterion = sigmaMax / (ia_double_t)NN - muT*muT;
 	}
 	return (1);
 }
@@ -184,177 +281,19 @@ ia_int32_t ia_otsu_2(ia_signal_p histogram,
 					ia_double_t* areawhite,
 					ia_double_t* maxcriterion)
 {
-	ia_uint32_t NN;
-	ia_double_t NN_1;
-    ia_int32_t opti_1, omg_1, opti_omg1; 
-	ia_int32_t opti_2, omg_2, opti_omg2;
-	ia_int32_t opti_3, omg_3, opti_omg3;
-	ia_double_t mu_1, opti_mu1;
-	ia_double_t mu_2, opti_mu2;
-	ia_double_t mu_3, opti_mu3;
-	ia_int32_t *Mju, *Omega;
-	ia_double_t muT, sigma, sigma_1, sigma_2, sigma_3, sigmaMax = -1.0;
-	ia_int32_t i, t, t1, t2;
-
-	/* sum all histo values */
-	NN = 0;
-	for (t=0; t < histogram->length; t++) 
-		NN += histogram->get_pixel(histogram, t);
-
-	if ( NN == 0L) 
+	ia_uint32_t tresholds[2], means[3];
+	ia_double_t areas[3];
+	ia_int32_t result = ia_otsu_n(histogram, 2, tresholds, mean, means, areas, maxcriterion);
+	if (result > 0)
 	{
-		/* input histo is empty */
-		return (-1);
+		*treshold1 = tresholds[0];
+		*treshold2 = tresholds[1];
+		if (meanblack) *meanblack = means[0];
+		if (meangrey)  *meangrey  = means[1];
+		if (meanwhite) *meanwhite = means[2];
+		if (areablack) *areablack = areas[0];
+		if (areagrey)  *areagrey  = areas[1];
+		if (areawhite) *areawhite = areas[2];
 	}
-	else
-	{
-		NN_1 = 1./(double)NN;
-	}
-
-	Omega = (ia_int32_t*)malloc(histogram->length * sizeof(ia_int32_t));
-	if (!Omega)
-	{
-		/* not enough memory */
-		return (-2);
-	}
-
-	Omega[0] = histogram->get_pixel(histogram, 0);
-
-	/* probability accummulation */
-	for (i = 1; i < histogram->length; i++) 
-		Omega[i] = Omega[i-1] + histogram->get_pixel(histogram, i);
-
-	Mju = (ia_int32_t*)malloc(histogram->length*sizeof(ia_int32_t));
-	if (!Mju)
-	{
-		/* not enough memory */
-		free( (void*)Omega );
-		return (-2);
-	}
-
-	/* mean value accummulation */
-	Mju[0] = 0;
-	for (i = 1; i < histogram->length; i++) 
-		Mju[i] = Mju[i-1] + i*histogram->get_pixel(histogram, i);
-
-	/* common mean value */
-	muT = Mju[histogram->length-1];
-
-	/* Start thresholding (t1: 0 -:- histosize-3) */
-	for (t1 = 0; t1 < histogram->length-2; t1++)
-	{
-		omg_1 = Omega[t1];                                 
-		if (omg_1 > 0) 
-		{ 
-			mu_1 = (ia_double_t)Mju[t1];         
-			sigma_1 = mu_1*mu_1/(ia_double_t)omg_1; 
-		}
-		else    
-		{ 
-			omg_1 = 0; 
-			mu_1 = sigma_1 = 0.0; 
-		}     
-
-		/* Start thresholding (t2: t1+1 -:- LvlN-2) */
-		for (t2 = t1+1; t2 < histogram->length-1; t2++) 
-		{
-			omg_2 = Omega[t2] - Omega[t1];
-			if (omg_2 > 0) 
-			{ 
-				mu_2 = (ia_double_t)(Mju[t2] - Mju[t1]);
-				sigma_2 = mu_2*mu_2/(ia_double_t)omg_2; 
-			}
-			else    
-			{ 
-				omg_2 = 0; 
-				mu_2 = sigma_2 = 0.0; 
-			} /* Omega[t1+1 -:- t2] == 0.0 */
-
-			omg_3 = Omega[histogram->length-1] - Omega[t2];
-			if (omg_3 > 0) 
-			{ 
-				mu_3 = (ia_double_t)(Mju[histogram->length-1] - Mju[t2]);
-				sigma_3 = mu_3*mu_3/(ia_double_t)omg_3; 
-			}
-			else    
-			{
-				omg_3 = 0; 
-				mu_3 = sigma_3 = 0.0; 
-			} /* Omega[t2+1 -:- histosize-1] == 0.0 */
-
-			sigma = sigma_1 + sigma_2 + sigma_3;
-
-			if (sigmaMax < sigma)
-			{ 
-				opti_1 = t1;   
-				opti_mu1 = mu_1; 
-				opti_omg1 = omg_1;
-				opti_2 = t2;    
-				opti_mu2 = mu_2; 
-				opti_omg2 = omg_2;
-				opti_3 = histogram->length-1; 
-				opti_mu3 = mu_3; 
-				opti_omg3 = omg_3;
-				sigmaMax = sigma;
-			}
-		}
-	}
-	free( (void*)Mju );
-	free( (void*)Omega );
-
-	/* return results */
-	muT *= NN_1;
-	*treshold1 = opti_1; 
-	*treshold2 = opti_2; 
-	if (mean)
-	{
-		*mean = (int)floor(muT+0.5);
-	}
-
-	if (meanblack)
-	{
-		if (opti_omg1 > 0) 
-			*meanblack = (int)floor(opti_mu1/(double)opti_omg1 + 0.5); 
-		else 
-			*meanblack = 0;
-	}
-
-	if (meangrey)
-	{
-		if (opti_omg2 > 0) 
-			*meangrey = (int)floor(opti_mu2/(double)opti_omg2 + 0.5); 
-		else 
-			*meangrey = 0;
-	}
-
-	if (meanwhite)
-	{
-		if (opti_omg3 > 0) 
-			*meanwhite = (int)floor(opti_mu3/(double)opti_omg3 + 0.5); 
-		else 
-			*meanwhite = 0;
-	}
-
-	if (areablack)
-	{
-		*areablack = opti_omg1*NN_1;
-	}
-
-	if (areawhite)
-	{
-		*areawhite = opti_omg2*NN_1;
-	}
-
-	if (areagrey)
-	{
-		*areagrey = opti_omg3*NN_1;
-	}
-
-	if (maxcriterion)
-	{
-		sigmaMax *= NN_1; 
-		sigmaMax -= muT*muT; /* to Otsu origi criterion */
-		*maxcriterion = sigmaMax;
-	}
-	return (1);
+	return result;
 }
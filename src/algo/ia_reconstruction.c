@@ -0,0 +1,420 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_reconstruction.c                                */
+/* Description:   Morphological reconstruction                       */
+/*                                                                   */
+/*********************************************************************/
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <ia/algo/ia_reconstruction.h>
+
+/*
+ * The images are worked on as byte buffers framed by one pixel, the
+ * IAT_BOOL pixels unpacked to 0 and 1. The frame is 0 in the marker and
+ * in the mask, so it never takes part. Reconstructions by erosion are
+ * made as reconstructions by dilation of the complements
+ */
+typedef enum
+{
+	IA_RECONSTRUCTION_MARKER,      /* the reconstruction */
+	IA_RECONSTRUCTION_DIFFERENCE,  /* mask minus the reconstruction */
+	IA_RECONSTRUCTION_POSITIVE     /* IAT_BOOL, 1 where the mask is above the reconstruction */
+} ia_reconstruction_result_t;
+
+typedef struct
+{
+	ia_uint32_t* items;
+	ia_uint32_t  size;     /* power of 2 */
+	ia_uint32_t  head;
+	ia_uint32_t  count;
+} ia_reconstruction_queue_t;
+
+static ia_bool_t ia_reconstruction_push(ia_reconstruction_queue_t* queue, ia_uint32_t item)
+{
+	if (queue->count == queue->size)
+	{
+		ia_uint32_t  first = queue->size - queue->head;
+		ia_uint32_t* items = (ia_uint32_t*)malloc(2 * queue->size * sizeof(ia_uint32_t));
+		if (!items)
+		{
+			return IA_FALSE;
+		}
+		memcpy(items, queue->items + queue->head, first * sizeof(ia_uint32_t));
+		memcpy(items + first, queue->items, queue->head * sizeof(ia_uint32_t));
+		free(queue->items);
+		queue->items = items;
+		queue->head  = 0;
+		queue->size *= 2;
+	}
+	queue->items[(queue->head + queue->count++) & (queue->size - 1)] = item;
+	return IA_TRUE;
+}
+
+/*
+ * Vincent's hybrid reconstruction by dilation of the marker under the
+ * mask, marker <= mask. A forward and a backward raster scan carry the
+ * values along the scan directions, the pixels of the backward scan
+ * which could still raise a neighbor go to a FIFO queue and the queue
+ * propagates the rest, every pixel raised is queued again. n is the
+ * number of the neighbors before a pixel in the raster order, 2 or 4, 
+ * a constant in every call so the loops over them unroll
+ */
+static ia_bool_t ia_reconstruction_scan(ia_uint8_t* marker, const ia_uint8_t* mask, ia_int32_t width, ia_int32_t height,
+										const ia_int32_t n)
+{
+	ia_int32_t  w = width + 2;
+	ia_int32_t  offset[4];
+	ia_int32_t  x, y, k;
+	ia_uint32_t p, q;
+	ia_uint8_t  v, *line;
+	ia_bool_t   ok = IA_TRUE;
+	ia_reconstruction_queue_t queue;
+
+	/* p - offset are the neighbors before p in the raster order */
+	offset[0] = 1;
+	offset[1] = w;
+	offset[2] = w + 1;
+	offset[3] = w - 1;
+
+	queue.size  = 4096;
+	queue.head  = 0;
+	queue.count = 0;
+	queue.items = (ia_uint32_t*)malloc(queue.size * sizeof(ia_uint32_t));
+	line        = (ia_uint8_t*)malloc(w);
+	if (!queue.items || !line)
+	{
+		free(queue.items);
+		free(line);
+		return IA_FALSE;
+	}
+
+	/*
+	 * The maximum of a pixel and its neighbors in the row before goes to 
+	 * line first, then only the neighbor just set is left to the scan
+	 */
+	for (y=1; y<=height; y++)
+	{
+		const ia_uint8_t* row = marker + (ia_uint32_t)y * w + 1;
+		for (x=0; x<width; x++)
+		{
+			v = MAX(row[x], row[x - w]);
+			for (k=2; k<n; k++)
+				v = MAX(v, row[x - offset[k]]);
+			line[x] = v;
+		}
+		for (v=0, p=(ia_uint32_t)y * w + 1, x=0; x<width; x++, p++)
+		{
+			v = MAX(v, line[x]);
+			v = MIN(v, mask[p]);
+			marker[p] = v;
+		}
+	}
+
+	for (y=height; y>=1 && ok; y--)
+	{
+		const ia_uint8_t* row = marker + (ia_uint32_t)y * w + 1;
+		for (x=0; x<width; x++)
+		{
+			v = MAX(row[x], row[x + w]);
+			for (k=2; k<n; k++)
+				v = MAX(v, row[x + offset[k]]);
+			line[x] = v;
+		}
+		for (v=0, p=(ia_uint32_t)y * w + width, x=width - 1; x>=0; x--, p--)
+		{
+			v = MAX(v, line[x]);
+			v = MIN(v, mask[p]);
+			marker[p] = v;
+		}
+		/* the pixels which could still raise a neighbor after them */
+		for (p=(ia_uint32_t)y * w + width, x=0; x<width && ok; x++, p--)
+		{
+			for (k=0; k<n; k++)
+			{
+				q = p + offset[k];
+				if (marker[q] < marker[p] && marker[q] < mask[q])
+				{
+					ok = ia_reconstruction_push(&queue, p);
+					break;
+				}
+			}
+		}
+	}
+	free(line);
+
+	while (queue.count && ok)
+	{
+		p = queue.items[queue.head];
+		queue.head = (queue.head + 1) & (queue.size - 1);
+		queue.count--;
+		v = marker[p];
+		for (k=0; k<2 * n; k++)
+		{
+			q = k < n ? p - offset[k] : p + offset[k - n];
+			if (marker[q] < v && marker[q] != mask[q])
+			{
+				marker[q] = MIN(v, mask[q]);
+				if (!(ok = ia_reconstruction_push(&queue, q)))
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	free(queue.items);
+	return ok;
+}
+
+static ia_bool_t ia_reconstruction_run(ia_uint8_t* marker, const ia_uint8_t* mask, ia_int32_t width, ia_int32_t height,
+									   ia_connectivity_t connectivity)
+{
+	if (connectivity == IA_CONNECTIVITY_8)
+	{
+		return ia_reconstruction_scan(marker, mask, width, height, 4);
+	}
+	return ia_reconstruction_scan(marker, mask, width, height, 2);
+}
+
+static ia_bool_t ia_reconstruction_supported(const char* name, ia_image_p image, ia_image_p other)
+{
+	if (image->format != IAT_BOOL && !(image->is_gray && image->format == IAT_UINT_8))
+	{
+		ASSERT(0), "%s -> Not supported format %s!\n", name, ia_format_name(image->format));
+		return IA_FALSE;
+	}
+	if (other && (other->format != image->format || other->width != image->width || other->height != image->height))
+	{
+		ASSERT(0), "%s -> The marker and the mask differ in size or format!\n", name);
+		return IA_FALSE;
+	}
+	return IA_TRUE;
+}
+
+/* loads the image into a framed buffer, complemented if invert */
+static ia_uint8_t* ia_reconstruction_load(ia_image_p image, ia_bool_t invert)
+{
+	ia_int32_t  w = image->width + 2, x, y;
+	ia_uint8_t  top = (ia_uint8_t)(!invert ? 0 : image->format == IAT_BOOL ? 1 : 0xFF);
+	ia_uint8_t* buffer = (ia_uint8_t*)calloc((ia_uint32_t)w * (image->height + 2), 1);
+	if (!buffer)
+	{
+		return NULL;
+	}
+	for (y=0; y<image->height; y++)
+	{
+		ia_uint8_t*       row = buffer + (ia_uint32_t)(y + 1) * w + 1;
+		const ia_uint8_t* src = IA_IMAGE_ROW(image, y);
+		if (image->format == IAT_BOOL)
+		{
+			for (x=0; x<image->width; x++)
+				row[x] = (ia_uint8_t)(((src[x >> 3] >> (x & 7)) & 1) ^ top);
+		}
+		else
+		{
+			for (x=0; x<image->width; x++)
+				row[x] = src[x] ^ top;
+		}
+	}
+	return buffer;
+}
+
+/* new buffer with the marker made of the mask, the mask minus amount or its border pixels if border */
+static ia_uint8_t* ia_reconstruction_marker(const ia_uint8_t* mask, ia_int32_t width, ia_int32_t height,
+											ia_uint32_t amount, ia_bool_t border)
+{
+	ia_int32_t  w = width + 2, y;
+	ia_uint32_t k, size = (ia_uint32_t)w * (height + 2);
+	ia_uint8_t* marker;
+	if (!mask || !(marker = (ia_uint8_t*)malloc(size)))
+	{
+		return NULL;
+	}
+	if (border)
+	{
+		memset(marker, 0, size);
+		memcpy(marker + w + 1, mask + w + 1, width);
+		memcpy(marker + (ia_uint32_t)height * w + 1, mask + (ia_uint32_t)height * w + 1, width);
+		for (y=1; y<=height; y++)
+		{
+			marker[(ia_uint32_t)y * w + 1]     = mask[(ia_uint32_t)y * w + 1];
+			marker[(ia_uint32_t)y * w + width] = mask[(ia_uint32_t)y * w + width];
+		}
+	}
+	else
+	{
+		for (k=0; k<size; k++)
+			marker[k] = mask[k] > amount ? (ia_uint8_t)(mask[k] - amount) : 0;
+	}
+	return marker;
+}
+
+/*
+ * Reconstructs the marker under the mask and returns the result in image
+ * of the format of like, complemented back if invert. Releases the buffers
+ */
+static ia_image_p ia_reconstruction_finish(ia_image_p like, ia_uint8_t* marker, ia_uint8_t* mask,
+										   ia_connectivity_t connectivity, ia_bool_t invert, ia_reconstruction_result_t result)
+{
+	ia_int32_t  width = like->width, height = like->height, w = width + 2, x, y;
+	ia_uint32_t k, size = (ia_uint32_t)w * (height + 2);
+	ia_image_p  output = NULL;
+
+	if (marker && mask && ia_reconstruction_run(marker, mask, width, height, connectivity))
+	{
+		ia_format_t format = result == IA_RECONSTRUCTION_POSITIVE ? IAT_BOOL : like->format;
+		ia_uint8_t  top    = (ia_uint8_t)(!invert ? 0 : format == IAT_BOOL ? 1 : 0xFF);
+		output = ia_image_new(width, height, format, IA_IMAGE_GRAY);
+		if (output)
+		{
+			if (result != IA_RECONSTRUCTION_MARKER)
+			{
+				for (k=0; k<size; k++)
+					marker[k] = (ia_uint8_t)(mask[k] - marker[k]);
+			}
+			for (y=0; y<height; y++)
+			{
+				const ia_uint8_t* row = marker + (ia_uint32_t)(y + 1) * w + 1;
+				ia_uint8_t*       dst = IA_IMAGE_ROW(output, y);
+				if (format == IAT_BOOL)
+				{
+					for (x=0; x<width; x++)
+						if ((row[x] ^ top) != 0)
+							dst[x >> 3] |= (ia_uint8_t)(1 << (x & 7));
+				}
+				else
+				{
+					for (x=0; x<width; x++)
+						dst[x] = row[x] ^ top;
+				}
+			}
+		}
+	}
+	else if (marker && mask)
+	{
+		ASSERT(0), "ia_reconstruction -> Out of memory!\n");
+	}
+
+	free(marker);
+	free(mask);
+	return output;
+}
+
+/* marker = min(marker, mask) */
+static void ia_reconstruction_clip(ia_uint8_t* marker, const ia_uint8_t* mask, ia_image_p like)
+{
+	ia_uint32_t k, size = (ia_uint32_t)(like->width + 2) * (like->height + 2);
+	if (marker && mask)
+	{
+		for (k=0; k<size; k++)
+			marker[k] = MIN(marker[k], mask[k]);
+	}
+}
+
+ia_image_p ia_reconstruction_dilation(ia_image_p marker, ia_image_p mask, ia_connectivity_t connectivity)
+{
+	ia_uint8_t *j, *i;
+	if (!ia_reconstruction_supported("ia_reconstruction_dilation", mask, marker))
+	{
+		return NULL;
+	}
+	j = ia_reconstruction_load(marker, IA_FALSE);
+	i = ia_reconstruction_load(mask, IA_FALSE);
+	ia_reconstruction_clip(j, i, mask);
+	return ia_reconstruction_finish(mask, j, i, connectivity, IA_FALSE, IA_RECONSTRUCTION_MARKER);
+}
+
+ia_image_p ia_reconstruction_erosion(ia_image_p marker, ia_image_p mask, ia_connectivity_t connectivity)
+{
+	ia_uint8_t *j, *i;
+	if (!ia_reconstruction_supported("ia_reconstruction_erosion", mask, marker))
+	{
+		return NULL;
+	}
+	j = ia_reconstruction_load(marker, IA_TRUE);
+	i = ia_reconstruction_load(mask, IA_TRUE);
+	ia_reconstruction_clip(j, i, mask);
+	return ia_reconstruction_finish(mask, j, i, connectivity, IA_TRUE, IA_RECONSTRUCTION_MARKER);
+}
+
+/* the reconstruction by erosion of the border pixels over the image */
+ia_image_p ia_reconstruction_fill_holes(ia_image_p image, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_fill_holes", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_TRUE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, 0, IA_TRUE),
+									mask, connectivity, IA_TRUE, IA_RECONSTRUCTION_MARKER);
+}
+
+/* the image minus the reconstruction by dilation of its border pixels */
+ia_image_p ia_reconstruction_clear_border(ia_image_p image, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_clear_border", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_FALSE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, 0, IA_TRUE),
+									mask, connectivity, IA_FALSE, IA_RECONSTRUCTION_DIFFERENCE);
+}
+
+/* the reconstruction by dilation of the image minus h */
+ia_image_p ia_reconstruction_h_maxima(ia_image_p image, ia_uint32_t h, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_h_maxima", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_FALSE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, h, IA_FALSE),
+									mask, connectivity, IA_FALSE, IA_RECONSTRUCTION_MARKER);
+}
+
+/* the reconstruction by erosion of the image plus h */
+ia_image_p ia_reconstruction_h_minima(ia_image_p image, ia_uint32_t h, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_h_minima", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_TRUE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, h, IA_FALSE),
+									mask, connectivity, IA_TRUE, IA_RECONSTRUCTION_MARKER);
+}
+
+/* the image above the reconstruction by dilation of the image minus 1 */
+ia_image_p ia_reconstruction_regional_maxima(ia_image_p image, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_regional_maxima", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_FALSE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, 1, IA_FALSE),
+									mask, connectivity, IA_FALSE, IA_RECONSTRUCTION_POSITIVE);
+}
+
+/* the regional maxima of the complement */
+ia_image_p ia_reconstruction_regional_minima(ia_image_p image, ia_connectivity_t connectivity)
+{
+	ia_uint8_t* mask;
+	if (!ia_reconstruction_supported("ia_reconstruction_regional_minima", image, NULL))
+	{
+		return NULL;
+	}
+	mask = ia_reconstruction_load(image, IA_TRUE);
+	return ia_reconstruction_finish(image, ia_reconstruction_marker(mask, image->width, image->height, 1, IA_FALSE),
+									mask, connectivity, IA_FALSE, IA_RECONSTRUCTION_POSITIVE);
+}
@@ -57,6 +57,8 @@ ia_bool_t ia_format_signed(ia_format_t format)
 	case IAT_INT_16:
 	case IAT_INT_24:
 	case IAT_INT_32:
+	case IAT_FLOAT:
+	case IAT_DOUBLE:
 		return 1;
 	}
 	return 0;
@@ -87,7 +89,7 @@ void ia_format_min_max(ia_format_t format, ia_int32_t* min, ia_uint32_t* max)
 			*max=0xFFFF;
 			break;
 		case IAT_INT_24:
-			*min=0x800000;
+			*min=-0x800000;
 			*max=0x7FFFFF;
 			break;
 		case IAT_UINT_24: 
@@ -102,6 +104,12 @@ void ia_format_min_max(ia_format_t format, ia_int32_t* min, ia_uint32_t* max)
 			*min=0;
 			*max=IA_MAX_UINT;
 			break;
+		case IAT_FLOAT:
+		case IAT_DOUBLE:
+			/* the range of the colors returned by get_pixel for the real formats */
+			*min=0x80000000;
+			*max=IA_MAX_INT;
+			break;
 	default:
 		ASSERT(0), "%s is invalid or not supported format by ia_format_min_max!\n", ia_format_names[format]);
 	}
@@ -71,7 +71,7 @@ typedef struct
 static ia_bool_t ia_gif_decode(FILE* fp, image_info_t* image_info, ia_image_p img, ia_int32_t opacity)
 {
 #define MaxStackSize  4096
-#define NullCode  (~0UL)
+#define NullCode  ((ia_uint32_t)~0UL)
 
 	ia_int32_t index;
 	ia_int32_t offset, y;
@@ -11,16 +11,22 @@
 #include <stdio.h>
 #include <malloc.h>
 #include <math.h>
+#include <string.h>
 #ifdef __GNUC__
 #include <strings.h>
 #else
-#include <string.h>
 #define strcasecmp _stricmp
 #endif
 #include <ia/ia_image.h>
 #include <ia/ia_signal.h>
 #include <ia/ia_line.h>
+#include <ia/ia_pixels.h>
 #include <ia/algo/ia_otsu.h>
+#include <ia/algo/ia_binarize.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifndef ABS
 #define ABS(a) ((a)>=0 ? (a) : (-(a)))
@@ -43,12 +49,17 @@ static void                ia_image_set_pixel_32         (struct _ia_image_t*, i
 static ia_uint32_t         ia_image_get_pixel_32         (struct _ia_image_t*, ia_uint16_t, ia_uint16_t);
 static void                ia_image_set_pixel            (struct _ia_image_t*, ia_uint16_t, ia_uint16_t, ia_uint32_t);
 static ia_uint32_t         ia_image_get_pixel            (struct _ia_image_t*, ia_uint16_t, ia_uint16_t);
+static void                ia_image_set_pixel_double     (struct _ia_image_t*, ia_uint16_t, ia_uint16_t, ia_double_t);
+static ia_double_t         ia_image_get_pixel_double     (struct _ia_image_t*, ia_uint16_t, ia_uint16_t);
 static void                ia_image_fill                 (struct _ia_image_t*, ia_uint32_t);
 static struct _ia_image_t* ia_image_convert_rgb          (struct _ia_image_t*);
 static struct _ia_image_t* ia_image_convert_gray         (struct _ia_image_t*, ia_format_t);
+static struct _ia_image_t* ia_image_convert              (struct _ia_image_t*, ia_format_t, ia_double_t, ia_double_t);
 static void                ia_image_normalize_colors     (struct _ia_image_t*, ia_int32_t, ia_uint32_t, ia_int32_t, ia_uint32_t);
 static void                ia_image_extract_hsv          (struct _ia_image_t*, ia_uint32_t, ia_uint32_t, ia_uint32_t, ia_uint32_t, ia_uint32_t, ia_uint32_t);
+static struct _ia_image_t* ia_image_extract_hsv_mask     (struct _ia_image_t*, const ia_hsv_range_t*, ia_int32_t);
 static void                ia_image_inverse              (struct _ia_image_t*);
+static void                ia_image_inverse_range        (struct _ia_image_t*, ia_int32_t, ia_uint32_t);
 static void                ia_image_mask                 (struct _ia_image_t*, struct _ia_image_t*, ia_mask_t);
 static struct _ia_image_t* ia_image_substract            (struct _ia_image_t*, struct _ia_image_t*);
 static void                ia_image_binarize_threshold   (struct _ia_image_t*, ia_int32_t);
@@ -79,77 +90,172 @@ ia_image_p ia_image_load_gif(const ia_string_t src);
 /*                        Implementation                             */
 /*********************************************************************/
 
+/*
+ * Integer RGB to HSV conversion. Hue is in [0, 359], saturation and value are in [0, 255].
+ * The results are the exact floors of the hexcone model formulas, so the
+ * vectorized row version below produces identical values.
+ */
 static void ia_rgb_to_hsv(ia_uint32_t color, ia_uint32_t* phue, ia_uint32_t* psat, ia_uint32_t* pval)
 {
-    float red = IA_RED(color) / 255.0f;
-    float green = IA_GREEN(color) / 255.0f;
-    float blue = IA_BLUE(color) / 255.0f;
-    float mn = red, mx = red, hue, saturation, value, delta;
-    int maxVal = 0;
+	ia_int32_t red = IA_RED(color);
+	ia_int32_t green = IA_GREEN(color);
+	ia_int32_t blue = IA_BLUE(color);
+	ia_int32_t mx = MAX(red, MAX(green, blue));
+	ia_int32_t mn = MIN(red, MIN(green, blue));
+	ia_int32_t delta = mx - mn;
+	ia_int32_t hue = 0;
+
+	if (delta)
+	{
+		/* red wins on ties, then green */
+		if (red == mx)
+			hue = green - blue;
+		else if (green == mx)
+			hue = blue - red;
+		else
+			hue = red - green;
 
-    if (green > mx) 
-	{ 
-		mx = green; 
-		maxVal = 1; 
-	}
+		/* floor(60 * hue / delta) */
+		hue = (hue >= 0) ? (60 * hue) / delta : -((60 * -hue + delta - 1) / delta);
 
-    if (blue > mx) 
-	{ 
-		mx = blue; 
-		maxVal = 2; 
+		if (red != mx)
+			hue += (green == mx) ? 120 : 240;
+
+		if (hue < 0) 
+		{
+			hue += 360;
+		}
 	}
 
-    if (green < mn) 
+	if (phue)
+		*phue = (ia_uint32_t)hue;
+	if (psat)
+		*psat = mx ? (ia_uint32_t)((255 * delta) / mx) : 0;
+	if (pval)
+		*pval = (ia_uint32_t)mx;
+}
+
+/*
+ * Converts a row of RGB colors to HSV components.
+ * With SSE2 8 pixels are converted per iteration. The divisions are done in
+ * single precision which is exact here, all quotients are below 256 and
+ * at least 1/255 away from the next integer.
+ */
+static void ia_rgb_to_hsv_row(const ia_uint32_t* colors, ia_int32_t count, ia_uint16_t* hues, ia_uint8_t* sats, ia_uint8_t* vals)
+{
+	ia_int32_t i = 0;
+#ifdef __SSE2__
+	const __m128i mask  = _mm_set1_epi32(0xFF);
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128i ones  = _mm_cmpeq_epi16(zero, zero);
+	const __m128i one   = _mm_set1_epi16(1);
+	const __m128i h120  = _mm_set1_epi16(120);
+	const __m128i h240  = _mm_set1_epi16(240);
+	const __m128i h360  = _mm_set1_epi32(360);
+	const __m128  f60   = _mm_set1_ps(60.0f);
+	const __m128  f255  = _mm_set1_ps(255.0f);
+
+	for (; i + 8 <= count; i += 8)
 	{
-		mn = green;
-	}
+		__m128i c0 = _mm_loadu_si128((const __m128i*)(colors + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i*)(colors + i + 4));
+		__m128i r  = _mm_packs_epi32(_mm_and_si128(c0, mask), _mm_and_si128(c1, mask));
+		__m128i g  = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c0, 8), mask), _mm_and_si128(_mm_srli_epi32(c1, 8), mask));
+		__m128i b  = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c0, 16), mask), _mm_and_si128(_mm_srli_epi32(c1, 16), mask));
+		__m128i mx = _mm_max_epi16(r, _mm_max_epi16(g, b));
+		__m128i mn = _mm_min_epi16(r, _mm_min_epi16(g, b));
+		__m128i delta = _mm_sub_epi16(mx, mn);
+		__m128i is_r  = _mm_cmpeq_epi16(r, mx);
+		__m128i is_g  = _mm_andnot_si128(is_r, _mm_cmpeq_epi16(g, mx));
+		__m128i is_b  = _mm_andnot_si128(_mm_or_si128(is_r, is_g), ones);
+		__m128i d = _mm_or_si128(
+			_mm_and_si128(is_r, _mm_sub_epi16(g, b)),
+			_mm_or_si128(_mm_and_si128(is_g, _mm_sub_epi16(b, r)), _mm_and_si128(is_b, _mm_sub_epi16(r, g))));
+		__m128i sector = _mm_or_si128(_mm_and_si128(is_g, h120), _mm_and_si128(is_b, h240));
+		__m128i den = _mm_max_epi16(delta, one);
+		__m128i mxd = _mm_max_epi16(mx, one);
+		__m128i hue[2], sat[2];
+		int k;
+
+		for (k = 0; k < 2; k++)
+		{
+			__m128i dk   = k ? _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16) : _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+			__m128i denk = k ? _mm_unpackhi_epi16(den, zero) : _mm_unpacklo_epi16(den, zero);
+			__m128i delk = k ? _mm_unpackhi_epi16(delta, zero) : _mm_unpacklo_epi16(delta, zero);
+			__m128i mxk  = k ? _mm_unpackhi_epi16(mxd, zero) : _mm_unpacklo_epi16(mxd, zero);
+			__m128i seck = k ? _mm_unpackhi_epi16(sector, zero) : _mm_unpacklo_epi16(sector, zero);
+			__m128  q    = _mm_div_ps(_mm_mul_ps(f60, _mm_cvtepi32_ps(dk)), _mm_cvtepi32_ps(denk));
+			__m128i t    = _mm_cvttps_epi32(q);
+			__m128i h;
+
+			/* truncation to floor for the negative quotients */
+			t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), q)));
+			h = _mm_add_epi32(seck, t);
+			h = _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, zero), h360));
+			hue[k] = _mm_andnot_si128(_mm_cmpeq_epi32(delk, zero), h);
+
+			sat[k] = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(f255, _mm_cvtepi32_ps(delk)), _mm_cvtepi32_ps(mxk)));
+		}
 
-    if (blue < mn) 
+		_mm_storeu_si128((__m128i*)(hues + i), _mm_packs_epi32(hue[0], hue[1]));
+		_mm_storel_epi64((__m128i*)(sats + i), _mm_packus_epi16(_mm_packs_epi32(sat[0], sat[1]), zero));
+		_mm_storel_epi64((__m128i*)(vals + i), _mm_packus_epi16(mx, zero));
+	}
+#endif
+	for (; i < count; i++)
 	{
-		mn = blue;
+		ia_uint32_t hue, sat, val;
+		ia_rgb_to_hsv(colors[i], &hue, &sat, &val);
+		hues[i] = (ia_uint16_t)hue;
+		sats[i] = (ia_uint8_t)sat;
+		vals[i] = (ia_uint8_t)val;
 	}
+}
 
-    delta = mx - mn;
-
-    value = mx;
-    if (mx != 0)
+/*
+ * Converts the RGB image row y to 8-bit gray as IA_GRAY does
+ */
+static void ia_image_gray_row(struct _ia_image_t* self, ia_uint16_t y, ia_uint8_t* grays)
+{
+	ia_uint16_t x;
+	switch (ia_format_size(self->format))
 	{
-        saturation = delta / mx;
+		case 24:
+			ia_pixels_rgb24_to_gray(IA_IMAGE_ROW(self, y), grays, self->width);
+		break;
+		case 32:
+			ia_pixels_rgb32_to_gray((const ia_uint32_t*)IA_IMAGE_ROW(self, y), grays, self->width);
+		break;
+		default:
+			for (x=0; x<self->width; x++)
+			{
+				ia_uint32_t c = self->get_pixel(self, x, y);
+				grays[x] = IA_GRAY(c);
+			}
 	}
-    else 
-	{
-        saturation = 0;
-        hue = 0;
-    }
+}
 
-    if (saturation == 0.0f)
+/*
+ * Returns the image row y as 32-bit RGB colors. 
+ * The buffer is used for formats other than 32-bit and must hold width colors.
+ */
+static const ia_uint32_t* ia_image_rgb_row(struct _ia_image_t* self, ia_uint16_t y, ia_uint32_t* buffer)
+{
+	ia_uint16_t x;
+	if (ia_format_size(self->format) == 32)
 	{
-		/* Arbritrary */
-        hue = 0;
-    } 
-	else 
+		return (const ia_uint32_t*)IA_IMAGE_ROW(self, y);
+	}
+	if (ia_format_size(self->format) == 24)
 	{
-        switch (maxVal)
-        {
-            case 0: hue = 0 + ( green - blue) / delta; break;    /* yel  < hue < mag  */
-            case 1: hue = 2 + ( blue - red )  / delta; break;    /* cyan < hue < yel  */
-            case 2: hue = 4 + ( red - green ) / delta; break;    /* mag  < hue < cyan */
-            default: hue = 0;
-        }
-    }
-
-    hue *= 60;
-    if (hue < 0) 
+		ia_pixels_rgb24_to_rgb32(IA_IMAGE_ROW(self, y), buffer, self->width);
+		return buffer;
+	}
+	for (x=0; x<self->width; x++)
 	{
-		hue += 360;
+		buffer[x] = self->get_pixel(self, x, y);
 	}
-
-	if (phue)
-		*phue = (ia_uint32_t)hue;
-	if (psat)
-		*psat = (ia_uint32_t)(255.0f * saturation);
-	if (pval)
-		*pval = (ia_uint32_t)(255.0f * value);
+	return buffer;
 }
 
 static void ia_hsv_to_rgb(ia_uint32_t ahue, ia_uint32_t asat, ia_uint32_t aval, ia_uint32_t* pcolor)
@@ -288,13 +394,18 @@ ia_image_p ia_image_from_data(ia_uint16_t width, ia_uint16_t height, ia_format_t
 	img->destroy                  = ia_image_destroy;
 	img->set_pixel                = ia_image_set_pixel;
 	img->get_pixel                = ia_image_get_pixel;
+	img->set_pixel_double         = ia_image_set_pixel_double;
+	img->get_pixel_double         = ia_image_get_pixel_double;
 	img->fill                     = ia_image_fill;
 	img->convert_rgb              = ia_image_convert_rgb;
 	img->convert_gray             = ia_image_convert_gray;
+	img->convert                  = ia_image_convert;
 	img->normalize_colors         = ia_image_normalize_colors;
 	img->mask                     = ia_image_mask;
 	img->extract_hsv              = ia_image_extract_hsv;
+	img->extract_hsv_mask         = ia_image_extract_hsv_mask;
 	img->inverse                  = ia_image_inverse;
+	img->inverse_range            = ia_image_inverse_range;
 	img->substract                = ia_image_substract;
 	img->get_min_max              = ia_image_get_min_max;
 	img->histogram                = ia_image_histogram;
@@ -378,17 +489,16 @@ static ia_uint16_t ia_image_get_pixel_16(struct _ia_image_t* self, ia_uint16_t x
 
 static void ia_image_set_pixel_24(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y, ia_uint32_t value)
 {
-	((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 0] = (ia_uint8_t)((value >>  0) & 0xFF);
-	((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 1] = (ia_uint8_t)((value >>  8) & 0xFF);
-	((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 2] = (ia_uint8_t)((value >> 16) & 0xFF);
+	ia_uint8_t* p = ((ia_uint8_t*)self->pixels.data) + 3*(y*self->width + x);
+	p[0] = (ia_uint8_t)((value >>  0) & 0xFF);
+	p[1] = (ia_uint8_t)((value >>  8) & 0xFF);
+	p[2] = (ia_uint8_t)((value >> 16) & 0xFF);
 }
 
 static ia_uint32_t ia_image_get_pixel_24(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y)
 {
-	return 
-	(((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 0] << 0) |
-	(((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 1] << 8) |
-	(((ia_uint8_t*)self->pixels.data)[3*(y*self->width + x) + 2] << 16);
+	const ia_uint8_t* p = ((const ia_uint8_t*)self->pixels.data) + 3*(y*self->width + x);
+	return (p[0] << 0) | (p[1] << 8) | (p[2] << 16);
 }
 
 static void ia_image_set_pixel_32(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y, ia_uint32_t value)
@@ -401,6 +511,31 @@ static ia_uint32_t ia_image_get_pixel_32(struct _ia_image_t* self, ia_uint16_t x
 	return ((ia_uint32_t*)self->pixels.data)[y*self->width + x];
 }
 
+/* first byte of the pixel for byte aligned formats */
+#define ia_image_pixel_ptr(self, x, y) (IA_IMAGE_ROW(self, y) + (((ia_uint32_t)(x) * ia_format_size((self)->format)) >> 3))
+
+/* real pixel of IAT_FLOAT or IAT_DOUBLE image */
+#define ia_image_get_real(self, x, y) ((self)->format == IAT_FLOAT ? \
+	(ia_double_t)((const ia_float_t*)IA_IMAGE_ROW(self, y))[x] : ((const ia_double_t*)IA_IMAGE_ROW(self, y))[x])
+
+static void ia_image_set_real(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y, ia_double_t value)
+{
+	if (self->format == IAT_FLOAT)
+		((ia_float_t*)IA_IMAGE_ROW(self, y))[x] = (ia_float_t)value;
+	else
+		((ia_double_t*)IA_IMAGE_ROW(self, y))[x] = value;
+}
+
+/* integral value saturated to the signed 32-bit range, NaN to the minimum */
+static ia_int32_t ia_image_clamp_int(ia_double_t value)
+{
+	if (!(value > (ia_double_t)IA_MIN_INT))
+		return IA_MIN_INT;
+	if (value >= (ia_double_t)IA_MAX_INT)
+		return IA_MAX_INT;
+	return (ia_int32_t)value;
+}
+
 static void ia_image_set_pixel(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y, ia_uint32_t value)
 {
 	if (x<self->width && y<self->height)
@@ -422,6 +557,10 @@ static void ia_image_set_pixel(struct _ia_image_t* self, ia_uint16_t x, ia_uint1
 		case IAT_UINT_32: case IAT_INT_32:
 				ia_image_set_pixel_32(self, x, y, (ia_uint32_t)value);
 				break;
+		case IAT_FLOAT: case IAT_DOUBLE:
+				/* the color is taken as signed as for IAT_INT_32 */
+				ia_image_set_real(self, x, y, (ia_int32_t)value);
+				break;
 			default:
 				ASSERT(0), "image:set_pixel(%d, %d, %X) -> Not supported format %d!\n", x, y, (unsigned int)value, self->format);
 		}
@@ -444,6 +583,9 @@ static ia_uint32_t ia_image_get_pixel(struct _ia_image_t* self, ia_uint16_t x, i
 				return ia_image_get_pixel_24(self, x, y);
 			case IAT_UINT_32: case IAT_INT_32:
 				return ia_image_get_pixel_32(self, x, y);
+			case IAT_FLOAT: case IAT_DOUBLE:
+				/* rounded half up and saturated as ia_pixels_convert does */
+				return (ia_uint32_t)ia_image_clamp_int(floor(ia_image_get_real(self, x, y) + 0.5));
 			default:
 				ASSERT(0), "image:get_pixel(%d, %d) -> Not supported format %d!\n", x, y, self->format);
 		}
@@ -451,12 +593,120 @@ static ia_uint32_t ia_image_get_pixel(struct _ia_image_t* self, ia_uint16_t x, i
 	return 0;
 }
 
+static void ia_image_set_pixel_double(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y, ia_double_t value)
+{
+	if (x<self->width && y<self->height)
+	{
+		if (self->format == IAT_BOOL)
+		{
+			ia_image_set_pixel_2(self, x, y, value >= 0.5);
+		}
+		else if (self->format == IAT_FLOAT || self->format == IAT_DOUBLE)
+		{
+			ia_image_set_real(self, x, y, value);
+		}
+		else
+		{
+			ia_pixels_convert(&value, IAT_DOUBLE, ia_image_pixel_ptr(self, x, y), self->format, 1, 1.0, 0.0);
+		}
+	}
+}
+
+static ia_double_t ia_image_get_pixel_double(struct _ia_image_t* self, ia_uint16_t x, ia_uint16_t y)
+{
+	ia_double_t value = 0.0;
+	if (x<self->width && y<self->height)
+	{
+		if (self->format == IAT_BOOL)
+		{
+			value = ia_image_get_pixel_2(self, x, y);
+		}
+		else if (self->format == IAT_FLOAT || self->format == IAT_DOUBLE)
+		{
+			value = ia_image_get_real(self, x, y);
+		}
+		else
+		{
+			ia_pixels_convert(ia_image_pixel_ptr(self, x, y), self->format, &value, IAT_DOUBLE, 1, 1.0, 0.0);
+		}
+	}
+	return value;
+}
+
+/*
+ * Fills the image with memset when all bytes of the pixel are the same,
+ * otherwise writes the first row with the pixel pattern and copies it to the others
+ */
 static void ia_image_fill(struct _ia_image_t* self, ia_uint32_t value)
 {
-	int i, j;
-	for (i=0; i<self->height; i++)
-		for (j=0; j<self->width; j++)
-			self->set_pixel(self, j, i, value);
+	ia_uint32_t i, j, stride = IA_IMAGE_STRIDE(self);
+	ia_uint8_t* pixels = (ia_uint8_t*)self->pixels.data;
+	ia_uint8_t  b0 = (ia_uint8_t)(value & 0xFF);
+	ia_uint8_t  b1 = (ia_uint8_t)((value >> 8) & 0xFF);
+	ia_uint8_t  b2 = (ia_uint8_t)((value >> 16) & 0xFF);
+	ia_uint8_t  b3 = (ia_uint8_t)((value >> 24) & 0xFF);
+
+	if (!self->width || !self->height)
+	{
+		return ;
+	}
+
+	switch (self->format)
+	{
+		case IAT_BOOL:
+		{
+			/* keep the padding bits of the last row byte clear */
+			ia_uint8_t tail = (self->width & 7) ? (ia_uint8_t)((1 << (self->width & 7)) - 1) : 0xFF;
+			b0 = (ia_uint8_t)value ? 0xFF : 0;
+			memset(pixels, b0, stride);
+			pixels[stride-1] &= tail;
+		}
+		break;
+		case IAT_UINT_8: case IAT_INT_8:
+			memset(pixels, b0, self->pixels.size);
+		return ;
+		case IAT_UINT_16: case IAT_INT_16:
+			if (b0 == b1)
+			{
+				memset(pixels, b0, self->pixels.size);
+				return ;
+			}
+			for (j=0; j<self->width; j++)
+				((ia_uint16_t*)pixels)[j] = (ia_uint16_t)value;
+		break;
+		case IAT_UINT_24: case IAT_INT_24:
+			if (b0 == b1 && b1 == b2)
+			{
+				memset(pixels, b0, self->pixels.size);
+				return ;
+			}
+			for (j=0; j<stride; j+=3)
+			{
+				pixels[j+0] = b0;
+				pixels[j+1] = b1;
+				pixels[j+2] = b2;
+			}
+		break;
+		case IAT_UINT_32: case IAT_INT_32:
+			if (b0 == b1 && b1 == b2 && b2 == b3)
+			{
+				memset(pixels, b0, self->pixels.size);
+				return ;
+			}
+			for (j=0; j<self->width; j++)
+				((ia_uint32_t*)pixels)[j] = value;
+		break;
+		default:
+			for (i=0; i<self->height; i++)
+				for (j=0; j<self->width; j++)
+					self->set_pixel(self, (ia_uint16_t)j, (ia_uint16_t)i, value);
+		return ;
+	}
+
+	for (i=1; i<self->height; i++)
+	{
+		memcpy(pixels + i*stride, pixels, stride);
+	}
 }
 
 static struct _ia_image_t* ia_image_convert_rgb(struct _ia_image_t* self)
@@ -480,9 +730,17 @@ static struct _ia_image_t* ia_image_convert_rgb(struct _ia_image_t* self)
 	{
 		ASSERT(ia_format_size(self->format) >= 24), "FIXME: Converting to 32 bit RGB format from %d bit is not supported!\n", ia_format_size(self->format));
 		img_new = ia_image_new(self->width, self->height, IAT_UINT_32, IA_IMAGE_RGB);
-		for (i=0; i<img_new->height; i++)
-		for (j=0; j<img_new->width; j++)
-			img_new->set_pixel(img_new, j, i, self->get_pixel(self, j, i));
+		if (ia_format_size(self->format) == 24)
+		{
+			for (i=0; i<img_new->height; i++)
+				ia_pixels_rgb24_to_rgb32(IA_IMAGE_ROW(self, i), (ia_uint32_t*)IA_IMAGE_ROW(img_new, i), self->width);
+		}
+		else
+		{
+			for (i=0; i<img_new->height; i++)
+			for (j=0; j<img_new->width; j++)
+				img_new->set_pixel(img_new, j, i, self->get_pixel(self, j, i));
+		}
 	} else
 	{
 		img_new=self->copy(self);
@@ -497,24 +755,35 @@ static struct _ia_image_t* ia_image_convert_gray(struct _ia_image_t* self, ia_fo
 	if (!self->is_gray)
 	{
 		/* convert RGB image */
-		ia_image_p img_temp;
+		ia_uint8_t* grays;
 		ASSERT(ia_format_size(self->format) >= 24), "FIXME: Converting to gray from %d bit RGB format is not supported!\n", ia_format_size(self->format));
-		img_temp = self->convert_rgb(self);
 		img_new = ia_image_new(self->width, self->height, format, IA_IMAGE_GRAY);
-		for (i=0; i<img_temp->height; i++)
-		for (j=0; j<img_temp->width; j++)
+		grays = (ia_uint8_t*)malloc(self->width);
+		for (i=0; i<self->height; i++)
 		{
-			ia_uint32_t c = img_temp->get_pixel(img_temp, j, i);
-			ia_uint8_t  g = IA_GRAY(c);
-			if (format == IAT_BOOL)
+			ia_uint8_t* row = ia_format_size(format) == 8 ? IA_IMAGE_ROW(img_new, i) : grays;
+			ia_image_gray_row(self, i, row);
+			if (row == grays)
 			{
-				img_new->set_pixel(img_new, j, i, (g>=128?1:0));
-			} else
-			{
-				img_new->set_pixel(img_new, j, i, g); 
+				for (j=0; j<self->width; j++)
+				{
+					ia_uint8_t g = grays[j];
+					if (format == IAT_BOOL)
+					{
+						img_new->set_pixel(img_new, j, i, (g>=128?1:0));
+					} else
+					{
+						img_new->set_pixel(img_new, j, i, g); 
+					}
+				}
 			}
 		}
-		img_temp->destroy(img_temp);
+		free(grays);
+	}
+	else if (format == IAT_FLOAT || format == IAT_DOUBLE || self->format == IAT_FLOAT || self->format == IAT_DOUBLE)
+	{
+		/* real pixel formats keep the color values */
+		img_new = self->convert(self, format, 1.0, 0.0);
 	}
 	else if (ia_format_size(self->format) != ia_format_size(format))
 	{
@@ -540,10 +809,113 @@ static struct _ia_image_t* ia_image_convert_gray(struct _ia_image_t* self, ia_fo
 	return img_new;
 }
 
+static struct _ia_image_t* ia_image_convert(struct _ia_image_t* self, ia_format_t format, ia_double_t scale, ia_double_t offset)
+{
+	ia_int32_t i;
+	ia_image_p img_new;
+	if (!self->is_gray)
+	{
+		ASSERT(0), "FIXME: RGB format is not supported by ia_image_convert!\n");
+		return NULL;
+	}
+
+	img_new = ia_image_new(self->width, self->height, format, IA_IMAGE_GRAY);
+	if (!img_new)
+	{
+		return NULL;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (i=0; i<self->height; i++)
+	{
+		ia_pixels_convert(IA_IMAGE_ROW(self, i), self->format, IA_IMAGE_ROW(img_new, i), format, self->width, scale, offset);
+	}
+	return img_new;
+}
+
+/* true for the float and double pixel formats */
+#define IA_IMAGE_IS_REAL(self) ((self)->format == IAT_FLOAT || (self)->format == IAT_DOUBLE)
+
+/* minimum and maximum color of a float or double image, 0 and 0 if empty */
+static void ia_image_real_min_max(struct _ia_image_t* self, ia_double_t* min, ia_double_t* max)
+{
+	ia_int32_t i;
+	*min = *max = 0.0;
+	if (!self->width || !self->height)
+	{
+		return ;
+	}
+	*min = *max = ia_image_get_real(self, 0, 0);
+#pragma omp parallel
+	{
+		ia_double_t lo = *min, hi = *max;
+		ia_int32_t  j;
+#pragma omp for schedule(static)
+		for (i=0; i<self->height; i++)
+		{
+			if (self->format == IAT_FLOAT)
+			{
+				const ia_float_t* row = (const ia_float_t*)IA_IMAGE_ROW(self, i);
+				for (j=0; j<self->width; j++)
+				{
+					if (row[j] > hi) hi = row[j];
+					if (row[j] < lo) lo = row[j];
+				}
+			}
+			else
+			{
+				const ia_double_t* row = (const ia_double_t*)IA_IMAGE_ROW(self, i);
+				for (j=0; j<self->width; j++)
+				{
+					if (row[j] > hi) hi = row[j];
+					if (row[j] < lo) lo = row[j];
+				}
+			}
+		}
+#pragma omp critical
+		{
+			if (hi > *max) *max = hi;
+			if (lo < *min) *min = lo;
+		}
+	}
+}
+
+/* dst = src * scale + offset over all pixels of a float or double image */
+static void ia_image_real_scale(struct _ia_image_t* self, ia_double_t scale, ia_double_t offset)
+{
+	ia_int32_t i;
+#pragma omp parallel for schedule(static)
+	for (i=0; i<self->height; i++)
+	{
+		ia_pixels_convert(IA_IMAGE_ROW(self, i), self->format, IA_IMAGE_ROW(self, i), self->format, self->width, scale, offset);
+	}
+}
+
 static void ia_image_normalize_colors(struct _ia_image_t* self, ia_int32_t min, ia_uint32_t max, ia_int32_t new_min, ia_uint32_t new_max)
 {
-	ia_uint16_t i,j;
+	ia_int32_t i, j;
 	ASSERT(self->is_gray), "FIXME: RGB format is not supported by ia_image_normalize_colors!\n");
+	if (IA_IMAGE_IS_REAL(self))
+	{
+		/* the real colors are mapped in double, all ranges are signed */
+		ia_double_t dmin = min, dmax = (ia_int32_t)max, scale;
+		if (!min && !max)
+		{
+			ia_image_real_min_max(self, &dmin, &dmax);
+		}
+		if (!new_min && !new_max)
+		{
+			ia_format_min_max(self->format, &new_min, &new_max);
+		}
+		if (dmin == dmax)
+		{
+			return ;
+		}
+		scale = ((ia_double_t)(ia_int32_t)new_max - new_min) / (dmax - dmin);
+		ia_image_real_scale(self, scale, new_min - dmin * scale);
+		return ;
+	}
+
 	if (!min && !max)
 	{
 		self->get_min_max(self, &min, &max);
@@ -554,15 +926,50 @@ static void ia_image_normalize_colors(struct _ia_image_t* self, ia_int32_t min,
 		ia_format_min_max(self->format, &new_min, &new_max);
 	}
 
-	if (min != max)
+	if (min == max)
 	{
-		for (i=0; i<self->height; i++)
-		for (j=0; j<self->width; j++)
+		return ;
+	}
+
+	switch (self->format)
+	{
+		case IAT_UINT_8: case IAT_INT_8:
+		case IAT_UINT_16: case IAT_INT_16:
 		{
-			ia_uint32_t c = self->get_pixel(self, j, i);
-			c=(ia_uint32_t)floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min));
-			self->set_pixel(self, j, i, c);
+			/* every color is mapped once, the rows go through the table */
+			void* lut = ia_pixels_normalize_lut(self->format, min, max, new_min, new_max);
+			if (!lut)
+			{
+				break;
+			}
+#pragma omp parallel for schedule(static)
+			for (i=0; i<self->height; i++)
+			{
+				if (ia_format_size(self->format) == 8)
+					ia_pixels_lut_8(IA_IMAGE_ROW(self, i), (const ia_uint8_t*)lut, self->width);
+				else
+					ia_pixels_lut_16((ia_uint16_t*)IA_IMAGE_ROW(self, i), (const ia_uint16_t*)lut, self->width);
+			}
+			free(lut);
 		}
+		return ;
+		case IAT_UINT_32: case IAT_INT_32:
+#pragma omp parallel for schedule(static)
+			for (i=0; i<self->height; i++)
+			{
+				ia_pixels_normalize_32((ia_uint32_t*)IA_IMAGE_ROW(self, i), self->width, ia_format_signed(self->format), min, max, new_min, new_max);
+			}
+		return ;
+		default:
+		break;
+	}
+
+	for (i=0; i<self->height; i++)
+	for (j=0; j<self->width; j++)
+	{
+		ia_uint32_t c = self->get_pixel(self, j, i);
+		c=(ia_uint32_t)floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min));
+		self->set_pixel(self, j, i, c);
 	}
 }
 
@@ -601,39 +1008,260 @@ static void ia_image_mask(struct _ia_image_t* self, struct _ia_image_t* mask, ia
 static void ia_image_extract_hsv(struct _ia_image_t* self, ia_uint32_t huemin, ia_uint32_t huemax, ia_uint32_t satmin, ia_uint32_t satmax, ia_uint32_t valmin, ia_uint32_t valmax)
 {
 	ia_int32_t i, j;
+	ia_uint32_t* buffer = (ia_uint32_t*)malloc(self->width * (sizeof(ia_uint32_t) + sizeof(ia_uint16_t) + 2));
+	ia_uint16_t* hues = (ia_uint16_t*)(buffer + self->width);
+	ia_uint8_t*  sats = (ia_uint8_t*)(hues + self->width);
+	ia_uint8_t*  vals = sats + self->width;
+	ia_bool_t    is_32 = (ia_format_size(self->format) == 32);
+
 	for (i=0; i<self->height; i++)
-	for (j=0; j<self->width; j++)
 	{
-		ia_uint32_t hue, sat, val;
-		ia_rgb_to_hsv(self->get_pixel(self, j, i), &hue, &sat, &val);
-		if (!((hue>=huemin && hue<=huemax) || (sat>=satmin && sat<=satmax) || (val>=valmin && val<=valmax)))
+		const ia_uint32_t* colors = ia_image_rgb_row(self, i, buffer);
+		ia_rgb_to_hsv_row(colors, self->width, hues, sats, vals);
+		for (j=0; j<self->width; j++)
 		{
-			self->set_pixel(self, j, i, 0);
+			ia_uint32_t hue = hues[j], sat = sats[j], val = vals[j];
+			if (!((hue>=huemin && hue<=huemax) || (sat>=satmin && sat<=satmax) || (val>=valmin && val<=valmax)))
+			{
+				if (is_32)
+					((ia_uint32_t*)colors)[j] = 0;
+				else
+					self->set_pixel(self, j, i, 0);
+			}
 		}
 	}
+	free(buffer);
 }
 
-static void ia_image_inverse(struct _ia_image_t* self)
+static ia_bool_t ia_hsv_in_range(const ia_hsv_range_t* range, ia_uint32_t hue, ia_uint32_t sat, ia_uint32_t val)
 {
-	ia_int32_t  i,j;
-	ia_int32_t  min;
-	ia_uint32_t max;
+	ia_bool_t hue_in = (range->huemin <= range->huemax) ? 
+		(hue >= range->huemin && hue <= range->huemax) : 
+		(hue >= range->huemin || hue <= range->huemax);
+	return hue_in && sat >= range->satmin && sat <= range->satmax && val >= range->valmin && val <= range->valmax;
+}
 
-	if (self->is_gray)
+/*
+ * Sets the bits of the mask row for the pixels inside any of the ranges.
+ * With SSE2 16 pixels are tested per iteration, giving 2 mask bytes.
+ */
+static void ia_hsv_mask_row(const ia_uint16_t* hues, const ia_uint8_t* sats, const ia_uint8_t* vals, ia_int32_t count, 
+							const ia_hsv_range_t* ranges, ia_int32_t nranges, ia_uint8_t* mask)
+{
+	ia_int32_t i = 0, r;
+#ifdef __SSE2__
+	for (; i + 16 <= count; i += 16)
 	{
-		self->get_min_max(self, &min, &max);
+		__m128i h0 = _mm_loadu_si128((const __m128i*)(hues + i));
+		__m128i h1 = _mm_loadu_si128((const __m128i*)(hues + i + 8));
+		__m128i s  = _mm_loadu_si128((const __m128i*)(sats + i));
+		__m128i v  = _mm_loadu_si128((const __m128i*)(vals + i));
+		__m128i selected = _mm_setzero_si128();
+		ia_int32_t bits;
+
+		for (r = 0; r < nranges; r++)
+		{
+			const ia_hsv_range_t* range = ranges + r;
+			__m128i hmin = _mm_set1_epi16((short)MIN(range->huemin, 360));
+			__m128i hmax = _mm_set1_epi16((short)MIN(range->huemax, 360));
+			__m128i smin = _mm_set1_epi8((char)MIN(range->satmin, 255));
+			__m128i smax = _mm_set1_epi8((char)MIN(range->satmax, 255));
+			__m128i vmin = _mm_set1_epi8((char)MIN(range->valmin, 255));
+			__m128i vmax = _mm_set1_epi8((char)MIN(range->valmax, 255));
+			/* hue >= hmin and hue <= hmax as 16-bit masks */
+			__m128i ge0 = _mm_cmpeq_epi16(_mm_max_epi16(h0, hmin), h0);
+			__m128i ge1 = _mm_cmpeq_epi16(_mm_max_epi16(h1, hmin), h1);
+			__m128i le0 = _mm_cmpeq_epi16(_mm_min_epi16(h0, hmax), h0);
+			__m128i le1 = _mm_cmpeq_epi16(_mm_min_epi16(h1, hmax), h1);
+			__m128i hue_in;
+
+			if (range->huemin <= range->huemax)
+				hue_in = _mm_packs_epi16(_mm_and_si128(ge0, le0), _mm_and_si128(ge1, le1));
+			else
+				hue_in = _mm_packs_epi16(_mm_or_si128(ge0, le0), _mm_or_si128(ge1, le1));
+
+			/* unsigned byte compares of saturation and value */
+			hue_in = _mm_and_si128(hue_in, _mm_cmpeq_epi8(_mm_max_epu8(s, smin), s));
+			hue_in = _mm_and_si128(hue_in, _mm_cmpeq_epi8(_mm_min_epu8(s, smax), s));
+			hue_in = _mm_and_si128(hue_in, _mm_cmpeq_epi8(_mm_max_epu8(v, vmin), v));
+			hue_in = _mm_and_si128(hue_in, _mm_cmpeq_epi8(_mm_min_epu8(v, vmax), v));
+			selected = _mm_or_si128(selected, hue_in);
+		}
 
-		for (i=0; i<self->height; i++)
-		for (j=0; j<self->width; j++)
-			self->set_pixel(self, j, i, min+max-self->get_pixel(self, j, i));
+		/* the first pixel goes to the least significant bit */
+		bits = _mm_movemask_epi8(selected);
+		mask[(i >> 3) + 0] = (ia_uint8_t)(bits & 0xFF);
+		mask[(i >> 3) + 1] = (ia_uint8_t)(bits >> 8);
 	}
-	else
+#endif
+	for (; i < count; i++)
 	{
+		for (r = 0; r < nranges; r++)
+		{
+			if (ia_hsv_in_range(ranges + r, hues[i], sats[i], vals[i]))
+			{
+				mask[i >> 3] |= (ia_uint8_t)(1 << (i & 7));
+				break;
+			}
+		}
+	}
+}
+
+static struct _ia_image_t* ia_image_extract_hsv_mask(struct _ia_image_t* self, const ia_hsv_range_t* ranges, ia_int32_t nranges)
+{
+	ia_image_p mask = ia_image_new(self->width, self->height, IAT_BOOL, IA_IMAGE_GRAY);
+	if (!mask)
+	{
+		return NULL;
+	}
+
+#pragma omp parallel
+	{
+		ia_int32_t i;
+		ia_uint32_t* buffer = (ia_uint32_t*)malloc(self->width * (sizeof(ia_uint32_t) + sizeof(ia_uint16_t) + 2));
+		ia_uint16_t* hues = (ia_uint16_t*)(buffer + self->width);
+		ia_uint8_t*  sats = (ia_uint8_t*)(hues + self->width);
+		ia_uint8_t*  vals = sats + self->width;
+
+#pragma omp for schedule(static)
 		for (i=0; i<self->height; i++)
-		for (j=0; j<self->width; j++)
 		{
-			ia_uint32_t color = self->get_pixel(self, j, i);
-			self->set_pixel(self, j, i, IA_RGB(ABS((ia_int32_t)IA_RED(color)-255), ABS((ia_int32_t)IA_GREEN(color)-255), ABS((ia_int32_t)IA_BLUE(color)-255)));
+			const ia_uint32_t* colors = ia_image_rgb_row(self, (ia_uint16_t)i, buffer);
+			ia_rgb_to_hsv_row(colors, self->width, hues, sats, vals);
+			ia_hsv_mask_row(hues, sats, vals, self->width, ranges, nranges, IA_IMAGE_ROW(mask, i));
+		}
+		free(buffer);
+	}
+	return mask;
+}
+
+static void ia_image_inverse(struct _ia_image_t* self)
+{
+	ia_image_inverse_range(self, 0, 0);
+}
+
+/*
+ * Replaces each gray color c with min+max-c, truncated to the pixel size
+ * as set_pixel does. With the full format range this is c xor all ones.
+ * RGB colors are inverted per channel and the range is ignored.
+ */
+static void ia_image_inverse_range(struct _ia_image_t* self, ia_int32_t min, ia_uint32_t max)
+{
+	ia_int32_t  i;
+	ia_uint32_t sum;
+
+	if (!self->is_gray)
+	{
+		switch (ia_format_size(self->format))
+		{
+			case 32:
+#pragma omp parallel for schedule(static)
+				for (i=0; i<self->height; i++)
+				{
+					ia_uint32_t* row = (ia_uint32_t*)IA_IMAGE_ROW(self, i);
+					ia_int32_t j;
+					/* the alpha byte is cleared as IA_RGB does */
+					for (j=0; j<self->width; j++)
+						row[j] = ~row[j] & 0xFFFFFF;
+				}
+			break;
+			case 24:
+#pragma omp parallel for schedule(static)
+				for (i=0; i<self->height; i++)
+				{
+					ia_uint8_t* row = IA_IMAGE_ROW(self, i);
+					ia_int32_t j;
+					for (j=0; j<3*self->width; j++)
+						row[j] ^= 0xFF;
+				}
+			break;
+			default:
+			{
+				ia_int32_t j;
+				for (i=0; i<self->height; i++)
+				for (j=0; j<self->width; j++)
+				{
+					ia_uint32_t color = self->get_pixel(self, j, i);
+					self->set_pixel(self, j, i, IA_RGB(ABS((ia_int32_t)IA_RED(color)-255), ABS((ia_int32_t)IA_GREEN(color)-255), ABS((ia_int32_t)IA_BLUE(color)-255)));
+				}
+			}
+		}
+		return ;
+	}
+
+	if (IA_IMAGE_IS_REAL(self))
+	{
+		/* c becomes min+max-c in double, the range is signed */
+		ia_double_t dmin = min, dmax = (ia_int32_t)max;
+		if (!min && !max)
+		{
+			ia_image_real_min_max(self, &dmin, &dmax);
+		}
+		ia_image_real_scale(self, -1.0, dmin + dmax);
+		return ;
+	}
+
+	if (!min && !max)
+	{
+		self->get_min_max(self, &min, &max);
+	}
+	sum = (ia_uint32_t)min + max;
+
+	switch (self->format)
+	{
+		case IAT_BOOL:
+		{
+			/* a pixel becomes (sum-1) if set or sum otherwise, both truncated to ia_bool_t */
+			ia_uint8_t if_set   = ((sum-1) & 0xFF) ? 0xFF : 0;
+			ia_uint8_t if_clear = (sum & 0xFF) ? 0xFF : 0;
+			ia_uint8_t tail     = (self->width & 7) ? (ia_uint8_t)((1 << (self->width & 7)) - 1) : 0xFF;
+			ia_uint32_t stride  = IA_IMAGE_STRIDE(self);
+#pragma omp parallel for schedule(static)
+			for (i=0; i<self->height; i++)
+			{
+				ia_uint8_t* row = IA_IMAGE_ROW(self, i);
+				ia_uint32_t j;
+				for (j=0; j<stride; j++)
+					row[j] = (row[j] & if_set) | (~row[j] & if_clear);
+				row[stride-1] &= tail;
+			}
+		}
+		break;
+		case IAT_UINT_8: case IAT_INT_8:
+		{
+			ia_uint8_t* pixels = (ia_uint8_t*)self->pixels.data;
+			ia_uint8_t  s8 = (ia_uint8_t)sum;
+			ia_int32_t  count = self->width * self->height;
+#pragma omp parallel for schedule(static)
+			for (i=0; i<count; i++)
+				pixels[i] = (ia_uint8_t)(s8 - pixels[i]);
+		}
+		break;
+		case IAT_UINT_16: case IAT_INT_16:
+		{
+			ia_uint16_t* pixels = (ia_uint16_t*)self->pixels.data;
+			ia_uint16_t  s16 = (ia_uint16_t)sum;
+			ia_int32_t   count = self->width * self->height;
+#pragma omp parallel for schedule(static)
+			for (i=0; i<count; i++)
+				pixels[i] = (ia_uint16_t)(s16 - pixels[i]);
+		}
+		break;
+		case IAT_UINT_32: case IAT_INT_32:
+		{
+			ia_uint32_t* pixels = (ia_uint32_t*)self->pixels.data;
+			ia_int32_t   count = self->width * self->height;
+#pragma omp parallel for schedule(static)
+			for (i=0; i<count; i++)
+				pixels[i] = sum - pixels[i];
+		}
+		break;
+		default:
+		{
+			ia_int32_t j;
+			for (i=0; i<self->height; i++)
+			for (j=0; j<self->width; j++)
+				self->set_pixel(self, j, i, sum-self->get_pixel(self, j, i));
 		}
 	}
 }
@@ -661,18 +1289,20 @@ static struct _ia_image_t* ia_image_substract(struct _ia_image_t* self, struct _
 	else
 	{
 		/* 8-bit grayscale pixel format for dividing RGB images */
+		ia_uint8_t* grays;
 		sub = ia_image_new(self->width, self->height, IAT_UINT_8, IA_IMAGE_GRAY);
+		grays = (ia_uint8_t*)malloc(self->width);
 		for (i=0; i<self->height; i++)
-		for (j=0; j<self->width; j++)
 		{
-			ia_int32_t color = self->get_pixel(self, j, i);
-			ia_int32_t substracted_color = IA_GRAY(color);
-			color = substractor->get_pixel(substractor, j, i);
-			color = IA_GRAY(color);
-			substracted_color -= color;
-			if (substracted_color < 0) substracted_color = -substracted_color;
-			sub->set_pixel(sub, j, i, substracted_color);
+			ia_uint8_t* row = IA_IMAGE_ROW(sub, i);
+			ia_image_gray_row(self, (ia_uint16_t)i, row);
+			ia_image_gray_row(substractor, (ia_uint16_t)i, grays);
+			for (j=0; j<self->width; j++)
+			{
+				row[j] = (ia_uint8_t)ABS((ia_int32_t)row[j] - (ia_int32_t)grays[j]);
+			}
 		}
+		free(grays);
 	}
 
 	return sub;
@@ -684,6 +1314,39 @@ static void ia_image_binarize_threshold(struct _ia_image_t* img, ia_int32_t thre
 	ia_int32_t min;
 	ia_uint32_t max;
 	ia_bool_t is_signed=ia_format_signed(img->format);
+	if (img->is_gray && img->format == IAT_UINT_8)
+	{
+		/* direct scan of the byte rows */
+		ia_int32_t y;
+		ia_uint8_t t = (ia_uint8_t)threshold;
+		if (threshold > 255 || threshold < 0)
+		{
+			/* as the unsigned compare below, a negative threshold is above every color */
+			memset(img->pixels.data, 0, img->pixels.size);
+			return ;
+		}
+#pragma omp parallel for schedule(static)
+		for (y=0; y<img->height; y++)
+		{
+			ia_uint8_t* row = IA_IMAGE_ROW(img, y);
+			ia_int32_t  x = 0;
+#ifdef __SSE2__
+			/* c >= t exactly when max(c, t) == c */
+			const __m128i t16 = _mm_set1_epi8((char)t);
+			for (; x + 16 <= img->width; x+=16)
+			{
+				__m128i c = _mm_loadu_si128((const __m128i*)(row + x));
+				_mm_storeu_si128((__m128i*)(row + x), _mm_cmpeq_epi8(_mm_max_epu8(c, t16), c));
+			}
+#endif
+			for (; x<img->width; x++)
+			{
+				row[x] = row[x] >= t ? 0xFF : 0;
+			}
+		}
+		return ;
+	}
+
 	ia_format_min_max(img->format, &min, &max);
 	for (i=0; i<img->height; i++)
 	for (j=0; j<img->width; j++)
@@ -791,6 +1454,16 @@ static int ia_image_binarize_otsu(struct _ia_image_t* img, ia_signal_p histo)
 	ia_int32_t result;
 	ia_uint32_t threshold;
 	int histoalloced = 0;
+	if (!histo && img->is_gray && img->format == IAT_UINT_8)
+	{
+		/* histogram bins on the stack, no signal in between */
+		if ((result=ia_binarize_otsu_threshold(img, &threshold)) > 0)
+		{
+			ia_image_binarize_threshold(img, threshold);
+		}
+		return result;
+	}
+
 	if (!histo)
 	{
 		histo = img->histogram(img, IA_COLOR_ELEMENT_VALUE);
@@ -836,7 +1509,43 @@ static void ia_image_get_min_max(struct _ia_image_t* self, ia_int32_t* min, ia_u
 {
 	ia_uint16_t i,j;
 	ia_bool_t is_signed=ia_format_signed(self->format);
+	if (IA_IMAGE_IS_REAL(self))
+	{
+		/* the real range rounded outwards, both bounds signed */
+		ia_double_t dmin, dmax;
+		ia_image_real_min_max(self, &dmin, &dmax);
+		*min = ia_image_clamp_int(floor(dmin));
+		*max = (ia_uint32_t)ia_image_clamp_int(ceil(dmax));
+		return ;
+	}
 	ia_format_min_max(self->format, (ia_int32_t*)max, (ia_uint32_t*)min);
+	if (self->format == IAT_UINT_8 || self->format == IAT_UINT_16)
+	{
+		/* direct scan of the unsigned gray formats */
+		ia_uint32_t k, count = self->width * self->height;
+		ia_uint32_t lo = *min, hi = *max;
+		if (self->format == IAT_UINT_8)
+		{
+			const ia_uint8_t* pixels = (const ia_uint8_t*)self->pixels.data;
+			for (k=0; k<count; k++)
+			{
+				lo = MIN(lo, pixels[k]);
+				hi = MAX(hi, pixels[k]);
+			}
+		}
+		else
+		{
+			const ia_uint16_t* pixels = (const ia_uint16_t*)self->pixels.data;
+			for (k=0; k<count; k++)
+			{
+				lo = MIN(lo, pixels[k]);
+				hi = MAX(hi, pixels[k]);
+			}
+		}
+		*min = (ia_int32_t)lo;
+		*max = hi;
+		return ;
+	}
 	for (i=0; i<self->height; i++)
 	for (j=0; j<self->width; j++)
 	{
@@ -893,30 +1602,76 @@ static ia_signal_p ia_image_histogram(struct _ia_image_t* self, ia_color_element
 {
 	ia_int32_t i, j, length = 256;
 	ia_signal_p histogram;
+	ia_uint32_t* bins;
 	if (color_element == IA_COLOR_ELEMENT_HUE)
 	{
 		length = 360;
 	}
 	histogram = ia_signal_new(length, IAT_UINT_32, IA_IMAGE_GRAY);
+	bins = (ia_uint32_t*)histogram->pixels.data;
 
-	for (i=0; i<self->height; i++)
-	for (j=0; j<self->width; j++)
+	if (self->is_gray && self->format == IAT_UINT_8)
 	{
-		ia_uint32_t color = self->get_pixel(self, j, i);
-		if (!self->is_gray) /* color element is ignored */
+		/* byte rows index the bins directly, used for the planes of ia_planes_t too */
+		for (i=0; i<self->height; i++)
 		{
-			switch (color_element)
+			const ia_uint8_t* row = IA_IMAGE_ROW(self, i);
+			for (j=0; j<self->width; j++)
 			{
-			case IA_COLOR_ELEMENT_RED:color = IA_RED(color); break;
-			case IA_COLOR_ELEMENT_GREEN:color = IA_GREEN(color); break;
-			case IA_COLOR_ELEMENT_BLUE: color = IA_BLUE(color); break;
-			case IA_COLOR_ELEMENT_HUE:ia_rgb_to_hsv(color, &color, 0, 0); break;
-			case IA_COLOR_ELEMENT_SATURATION: ia_rgb_to_hsv(color, 0, &color, 0); break;
-			default: /* case IA_COLOR_ELEMENT_VALUE */ ia_rgb_to_hsv(color, 0, 0, &color); break;
+				bins[row[j]]++;
 			}
-		} 
+		}
+	}
+	else if (self->is_gray) /* color element is ignored */
+	{
+		for (i=0; i<self->height; i++)
+		for (j=0; j<self->width; j++)
+		{
+			ia_uint16_t color = (ia_uint16_t)self->get_pixel(self, j, i);
+			if (color < length)
+			{
+				bins[color]++;
+			}
+		}
+	}
+	else
+	{
+		ia_uint32_t* buffer = (ia_uint32_t*)malloc(self->width * (sizeof(ia_uint32_t) + sizeof(ia_uint16_t) + 2));
+		ia_uint16_t* hues = (ia_uint16_t*)(buffer + self->width);
+		ia_uint8_t*  sats = (ia_uint8_t*)(hues + self->width);
+		ia_uint8_t*  vals = sats + self->width;
 
-		histogram->set_pixel(histogram, (ia_uint16_t)color, 1+histogram->get_pixel(histogram, (ia_uint16_t)color));
+		for (i=0; i<self->height; i++)
+		{
+			const ia_uint32_t* colors = ia_image_rgb_row(self, i, buffer);
+			switch (color_element)
+			{
+			case IA_COLOR_ELEMENT_RED:
+				for (j=0; j<self->width; j++) bins[IA_RED(colors[j])]++;
+				break;
+			case IA_COLOR_ELEMENT_GREEN:
+				for (j=0; j<self->width; j++) bins[IA_GREEN(colors[j])]++;
+				break;
+			case IA_COLOR_ELEMENT_BLUE:
+				for (j=0; j<self->width; j++) bins[IA_BLUE(colors[j])]++;
+				break;
+			default:
+				ia_rgb_to_hsv_row(colors, self->width, hues, sats, vals);
+				switch (color_element)
+				{
+				case IA_COLOR_ELEMENT_HUE:
+					for (j=0; j<self->width; j++) bins[hues[j]]++;
+					break;
+				case IA_COLOR_ELEMENT_SATURATION:
+					for (j=0; j<self->width; j++) bins[sats[j]]++;
+					break;
+				default: /* case IA_COLOR_ELEMENT_VALUE */
+					for (j=0; j<self->width; j++) bins[vals[j]]++;
+					break;
+				}
+			}
+		}
+		free(buffer);
 	}
 	return histogram;
 }
@@ -20,6 +20,7 @@
 #include <jpeglib.h>
 #include <jerror.h>
 #include <ia/ia_image.h>
+#include <ia/ia_pixels.h>
 
 #define DEFAULT_JPEG_QUALITY	100
 
@@ -178,7 +179,11 @@ ia_image_p ia_image_load_jpeg(const ia_string_t src)
 
 		(void) jpeg_read_scanlines ( &cinfo, row_pointer, 1 );
 
-		if (line_buf)
+		if (cinfo.output_components == 3)
+		{
+			ia_pixels_rgb24_to_rgb32(line_buf, (ia_uint32_t*)IA_IMAGE_ROW(img, loop), cinfo.output_width);
+		}
+		else if (line_buf)
 		{
 			ia_uint16_t i;
 			ia_uint8_t* p=line_buf;
@@ -403,6 +408,10 @@ void ia_image_save_jpeg(ia_image_p image, const ia_string_t dst)
 					line_buffer[i]=(ia_uint8_t)normalized->get_pixel(normalized, i, cinfo.next_scanline);
 				}
 			} 
+			else if (format_size == 32)
+			{
+				ia_pixels_rgb32_to_rgb24((const ia_uint32_t*)IA_IMAGE_ROW(image, cinfo.next_scanline), line_buffer, image->width);
+			}
 			else
 			{
 				ia_uint32_t color;
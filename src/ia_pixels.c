@@ -0,0 +1,736 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_pixels.c                                        */
+/* Description:   Pixel row conversion module                        */
+/*                                                                   */
+/*********************************************************************/
+
+#include <malloc.h>
+#include <math.h>
+#include <string.h>
+#include <ia/ia_pixels.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * The byte shuffle kernels are compiled for SSSE3 regardless of the
+ * compiler flags and selected at run time
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IA_PIXELS_SSSE3
+#include <tmmintrin.h>
+#define IA_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define ia_cpu_has_ssse3() __builtin_cpu_supports("ssse3")
+#endif
+
+/*********************************************************************/
+/*                        Implementation                             */
+/*********************************************************************/
+
+#ifdef IA_PIXELS_SSSE3
+
+/* 4 pixels per shuffle, loads and stores 16 bytes of which 12 are used */
+IA_TARGET_SSSE3 static ia_uint32_t ia_pixels_rgb24_to_rgb32_ssse3(const ia_uint8_t* src, ia_uint32_t* dst, ia_uint32_t count)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	ia_uint32_t i;
+	for (i = 0; 3 * i + 16 <= 3 * count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, shuffle));
+	}
+	return i;
+}
+
+IA_TARGET_SSSE3 static ia_uint32_t ia_pixels_rgb32_to_rgb24_ssse3(const ia_uint32_t* src, ia_uint8_t* dst, ia_uint32_t count)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	ia_uint32_t i;
+	/* the 4 extra bytes of each store are overwritten by the next one */
+	for (i = 0; 3 * i + 16 <= 3 * count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + 3 * i), _mm_shuffle_epi8(v, shuffle));
+	}
+	return i;
+}
+
+/* 8 pixels from 2 overlapping loads of bytes 0..15 and 8..23 */
+IA_TARGET_SSSE3 static ia_uint32_t ia_pixels_rgb24_to_gray_ssse3(const ia_uint8_t* src, ia_uint8_t* dst, ia_uint32_t count)
+{
+	const __m128i r0 = _mm_setr_epi8(0, -1, 3, -1, 6, -1,  9, -1, 12, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  7, -1, 10, -1, 13, -1);
+	const __m128i g0 = _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  8, -1, 11, -1, 14, -1);
+	const __m128i b0 = _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  9, -1, 12, -1, 15, -1);
+	const __m128i third = _mm_set1_epi16((short)43691);
+	ia_uint32_t i;
+	for (i = 0; 3 * i + 24 <= 3 * count; i += 8)
+	{
+		__m128i v0  = _mm_loadu_si128((const __m128i*)(src + 3 * i));
+		__m128i v1  = _mm_loadu_si128((const __m128i*)(src + 3 * i + 8));
+		__m128i sum = _mm_add_epi16(
+			_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)),
+			_mm_add_epi16(
+				_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)),
+				_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1))));
+		/* sum/3 == (sum*43691) >> 17 for all sums up to 765 */
+		__m128i gray = _mm_srli_epi16(_mm_mulhi_epu16(sum, third), 1);
+		_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(gray, gray));
+	}
+	return i;
+}
+
+/* 16 pixels from 3 loads of 16 bytes, each plane byte comes from exactly one of them */
+IA_TARGET_SSSE3 static ia_uint32_t ia_pixels_rgb24_to_planes_ssse3(const ia_uint8_t* src, ia_uint8_t* r, ia_uint8_t* g, ia_uint8_t* b, ia_uint32_t count)
+{
+	const __m128i r0 = _mm_setr_epi8( 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1);
+	const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13);
+	const __m128i g0 = _mm_setr_epi8( 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1);
+	const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14);
+	const __m128i b0 = _mm_setr_epi8( 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1);
+	const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15);
+	ia_uint32_t i;
+	for (i = 0; i + 16 <= count; i += 16)
+	{
+		__m128i v0 = _mm_loadu_si128((const __m128i*)(src + 3 * i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(src + 3 * i + 16));
+		__m128i v2 = _mm_loadu_si128((const __m128i*)(src + 3 * i + 32));
+		_mm_storeu_si128((__m128i*)(r + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, r0), _mm_shuffle_epi8(v1, r1)), _mm_shuffle_epi8(v2, r2)));
+		_mm_storeu_si128((__m128i*)(g + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, g0), _mm_shuffle_epi8(v1, g1)), _mm_shuffle_epi8(v2, g2)));
+		_mm_storeu_si128((__m128i*)(b + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, b0), _mm_shuffle_epi8(v1, b1)), _mm_shuffle_epi8(v2, b2)));
+	}
+	return i;
+}
+
+/* 16 pixels into 3 stores of 16 bytes, each output byte comes from exactly one plane */
+IA_TARGET_SSSE3 static ia_uint32_t ia_pixels_planes_to_rgb24_ssse3(const ia_uint8_t* r, const ia_uint8_t* g, const ia_uint8_t* b, ia_uint8_t* dst, ia_uint32_t count)
+{
+	const __m128i r0 = _mm_setr_epi8( 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5);
+	const __m128i g0 = _mm_setr_epi8(-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1);
+	const __m128i b0 = _mm_setr_epi8(-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1);
+	const __m128i r1 = _mm_setr_epi8(-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1);
+	const __m128i g1 = _mm_setr_epi8( 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10);
+	const __m128i b1 = _mm_setr_epi8(-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1);
+	const __m128i r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+	const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+	const __m128i b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+	ia_uint32_t i;
+	for (i = 0; i + 16 <= count; i += 16)
+	{
+		__m128i vr = _mm_loadu_si128((const __m128i*)(r + i));
+		__m128i vg = _mm_loadu_si128((const __m128i*)(g + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(dst + 3 * i),      _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r0), _mm_shuffle_epi8(vg, g0)), _mm_shuffle_epi8(vb, b0)));
+		_mm_storeu_si128((__m128i*)(dst + 3 * i + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r1), _mm_shuffle_epi8(vg, g1)), _mm_shuffle_epi8(vb, b1)));
+		_mm_storeu_si128((__m128i*)(dst + 3 * i + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r2), _mm_shuffle_epi8(vg, g2)), _mm_shuffle_epi8(vb, b2)));
+	}
+	return i;
+}
+
+#endif /* IA_PIXELS_SSSE3 */
+
+void ia_pixels_rgb24_to_rgb32(const ia_uint8_t* src, ia_uint32_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef IA_PIXELS_SSSE3
+	if (ia_cpu_has_ssse3())
+	{
+		i = ia_pixels_rgb24_to_rgb32_ssse3(src, dst, count);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i] = IA_RGB(src[3*i + 0], src[3*i + 1], src[3*i + 2]);
+	}
+}
+
+void ia_pixels_rgb32_to_rgb24(const ia_uint32_t* src, ia_uint8_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef IA_PIXELS_SSSE3
+	if (ia_cpu_has_ssse3())
+	{
+		i = ia_pixels_rgb32_to_rgb24_ssse3(src, dst, count);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[3*i + 0] = (ia_uint8_t)IA_RED(src[i]);
+		dst[3*i + 1] = (ia_uint8_t)IA_GREEN(src[i]);
+		dst[3*i + 2] = (ia_uint8_t)IA_BLUE(src[i]);
+	}
+}
+
+void ia_pixels_rgb24_to_gray(const ia_uint8_t* src, ia_uint8_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef IA_PIXELS_SSSE3
+	if (ia_cpu_has_ssse3())
+	{
+		i = ia_pixels_rgb24_to_gray_ssse3(src, dst, count);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i] = (ia_uint8_t)((src[3*i + 0] + src[3*i + 1] + src[3*i + 2]) / 3);
+	}
+}
+
+void ia_pixels_rgb32_to_gray(const ia_uint32_t* src, ia_uint8_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef __SSE2__
+	const __m128i mask  = _mm_set1_epi32(0xFF);
+	const __m128i third = _mm_set1_epi16((short)43691);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i c0  = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i c1  = _mm_loadu_si128((const __m128i*)(src + i + 4));
+		__m128i s0  = _mm_add_epi32(_mm_and_si128(c0, mask), _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(c0, 8), mask), _mm_and_si128(_mm_srli_epi32(c0, 16), mask)));
+		__m128i s1  = _mm_add_epi32(_mm_and_si128(c1, mask), _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(c1, 8), mask), _mm_and_si128(_mm_srli_epi32(c1, 16), mask)));
+		__m128i sum = _mm_packs_epi32(s0, s1);
+		__m128i gray = _mm_srli_epi16(_mm_mulhi_epu16(sum, third), 1);
+		_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(gray, gray));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i] = IA_GRAY(src[i]);
+	}
+}
+
+void ia_pixels_rgb24_to_planes(const ia_uint8_t* src, ia_uint8_t* r, ia_uint8_t* g, ia_uint8_t* b, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef IA_PIXELS_SSSE3
+	if (ia_cpu_has_ssse3())
+	{
+		i = ia_pixels_rgb24_to_planes_ssse3(src, r, g, b, count);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		r[i] = src[3*i + 0];
+		g[i] = src[3*i + 1];
+		b[i] = src[3*i + 2];
+	}
+}
+
+void ia_pixels_rgb32_to_planes(const ia_uint32_t* src, ia_uint8_t* r, ia_uint8_t* g, ia_uint8_t* b, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef __SSE2__
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i c[4];
+		int k, shift;
+		for (k = 0; k < 4; k++)
+		{
+			c[k] = _mm_loadu_si128((const __m128i*)(src + i + 4 * k));
+		}
+		for (shift = 0; shift < 24; shift += 8)
+		{
+			__m128i lo = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c[0], shift), mask), _mm_and_si128(_mm_srli_epi32(c[1], shift), mask));
+			__m128i hi = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(c[2], shift), mask), _mm_and_si128(_mm_srli_epi32(c[3], shift), mask));
+			ia_uint8_t* plane = shift == 0 ? r : (shift == 8 ? g : b);
+			_mm_storeu_si128((__m128i*)(plane + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		r[i] = (ia_uint8_t)IA_RED(src[i]);
+		g[i] = (ia_uint8_t)IA_GREEN(src[i]);
+		b[i] = (ia_uint8_t)IA_BLUE(src[i]);
+	}
+}
+
+void ia_pixels_planes_to_rgb24(const ia_uint8_t* r, const ia_uint8_t* g, const ia_uint8_t* b, ia_uint8_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef IA_PIXELS_SSSE3
+	if (ia_cpu_has_ssse3())
+	{
+		i = ia_pixels_planes_to_rgb24_ssse3(r, g, b, dst, count);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[3*i + 0] = r[i];
+		dst[3*i + 1] = g[i];
+		dst[3*i + 2] = b[i];
+	}
+}
+
+void ia_pixels_planes_to_rgb32(const ia_uint8_t* r, const ia_uint8_t* g, const ia_uint8_t* b, ia_uint32_t* dst, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i vr = _mm_loadu_si128((const __m128i*)(r + i));
+		__m128i vg = _mm_loadu_si128((const __m128i*)(g + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		__m128i rg_lo = _mm_unpacklo_epi8(vr, vg), rg_hi = _mm_unpackhi_epi8(vr, vg);
+		__m128i b0_lo = _mm_unpacklo_epi8(vb, zero), b0_hi = _mm_unpackhi_epi8(vb, zero);
+		_mm_storeu_si128((__m128i*)(dst + i),      _mm_unpacklo_epi16(rg_lo, b0_lo));
+		_mm_storeu_si128((__m128i*)(dst + i + 4),  _mm_unpackhi_epi16(rg_lo, b0_lo));
+		_mm_storeu_si128((__m128i*)(dst + i + 8),  _mm_unpacklo_epi16(rg_hi, b0_hi));
+		_mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(rg_hi, b0_hi));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[i] = IA_RGB(r[i], g[i], b[i]);
+	}
+}
+
+/*
+ * Format conversion goes through a block of floats when both formats
+ * fit exactly in a float (up to 16-bit integers and IAT_FLOAT), otherwise
+ * through a block of doubles. Loading, scaling and storing are separate
+ * passes over the block so each format needs one loader and one saver.
+ */
+#define IA_PIXELS_BLOCK 256
+
+static ia_bool_t ia_pixels_is_float_exact(ia_format_t format)
+{
+	switch (format)
+	{
+		case IAT_BOOL:
+		case IAT_UINT_8:  case IAT_INT_8:
+		case IAT_UINT_16: case IAT_INT_16:
+		case IAT_FLOAT:
+			return IA_TRUE;
+		default:
+			return IA_FALSE;
+	}
+}
+
+static void ia_pixels_load_float(const void* src, ia_format_t format, ia_float_t* buf, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+	switch (format)
+	{
+		case IAT_BOOL:
+			for (; i < count; i++)
+				buf[i] = (ia_float_t)((((const ia_uint8_t*)src)[i >> 3] >> (i & 7)) & 1);
+		break;
+		case IAT_UINT_8:
+		{
+			const ia_uint8_t* p = (const ia_uint8_t*)src;
+#ifdef __SSE2__
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i v  = _mm_loadu_si128((const __m128i*)(p + i));
+				__m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+				_mm_storeu_ps(buf + i,      _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+				_mm_storeu_ps(buf + i + 4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+				_mm_storeu_ps(buf + i + 8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+				_mm_storeu_ps(buf + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+			}
+#endif
+			for (; i < count; i++)
+				buf[i] = (ia_float_t)p[i];
+		}
+		break;
+		case IAT_INT_8:
+		{
+			const ia_int8_t* p = (const ia_int8_t*)src;
+#ifdef __SSE2__
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i v  = _mm_loadu_si128((const __m128i*)(p + i));
+				__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8), hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+				_mm_storeu_ps(buf + i,      _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+				_mm_storeu_ps(buf + i + 4,  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+				_mm_storeu_ps(buf + i + 8,  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+				_mm_storeu_ps(buf + i + 12, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+			}
+#endif
+			for (; i < count; i++)
+				buf[i] = (ia_float_t)p[i];
+		}
+		break;
+		case IAT_UINT_16:
+		{
+			const ia_uint16_t* p = (const ia_uint16_t*)src;
+#ifdef __SSE2__
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+				_mm_storeu_ps(buf + i,     _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+				_mm_storeu_ps(buf + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+			}
+#endif
+			for (; i < count; i++)
+				buf[i] = (ia_float_t)p[i];
+		}
+		break;
+		case IAT_INT_16:
+		{
+			const ia_int16_t* p = (const ia_int16_t*)src;
+#ifdef __SSE2__
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+				_mm_storeu_ps(buf + i,     _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)));
+				_mm_storeu_ps(buf + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)));
+			}
+#endif
+			for (; i < count; i++)
+				buf[i] = (ia_float_t)p[i];
+		}
+		break;
+		default: /* IAT_FLOAT */
+			memcpy(buf, src, count * sizeof(ia_float_t));
+	}
+}
+
+/* saturates to [lo, hi] and rounds half up as floor(v + 0.5), NaN goes to lo */
+static void ia_pixels_round_float(const ia_float_t* buf, ia_int32_t* out, ia_uint32_t count, ia_int32_t lo, ia_int32_t hi)
+{
+	ia_uint32_t i = 0;
+	const ia_float_t flo = (ia_float_t)lo, fhi = (ia_float_t)hi;
+#ifdef __SSE2__
+	const __m128 vlo = _mm_set1_ps(flo), vhi = _mm_set1_ps(fhi), half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= count; i += 4)
+	{
+		/* max_ps returns its second operand for NaN */
+		__m128 v = _mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(buf + i), vlo), vhi), half);
+		__m128i t = _mm_cvttps_epi32(v);
+		/* truncation rounds negative values up, the compare mask is -1 there */
+		t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), v)));
+		_mm_storeu_si128((__m128i*)(out + i), t);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		ia_float_t v = buf[i] > flo ? buf[i] : flo;
+		ia_int32_t t;
+		v = (v < fhi ? v : fhi) + 0.5f;
+		t = (ia_int32_t)v;
+		out[i] = (ia_float_t)t > v ? t - 1 : t;
+	}
+}
+
+static void ia_pixels_save_float(const ia_float_t* buf, ia_format_t format, void* dst, ia_uint32_t count)
+{
+	ia_int32_t  values[IA_PIXELS_BLOCK];
+	ia_int32_t  lo;
+	ia_uint32_t hi, i = 0;
+
+	if (format == IAT_FLOAT)
+	{
+		memcpy(dst, buf, count * sizeof(ia_float_t));
+		return ;
+	}
+
+	ia_format_min_max(format, &lo, &hi);
+	ia_pixels_round_float(buf, values, count, lo, (ia_int32_t)hi);
+	switch (format)
+	{
+		case IAT_BOOL:
+		{
+			ia_uint8_t* p = (ia_uint8_t*)dst;
+			/* the bits of the last byte after count are cleared */
+			for (; i < count; i += 8)
+			{
+				ia_uint32_t k, n = MIN(8, count - i);
+				ia_uint8_t bits = 0;
+				for (k = 0; k < n; k++)
+					bits |= (ia_uint8_t)(values[i + k] << k);
+				p[i >> 3] = bits;
+			}
+		}
+		break;
+		case IAT_UINT_8: case IAT_INT_8:
+		{
+			ia_uint8_t* p = (ia_uint8_t*)dst;
+#ifdef __SSE2__
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i lo16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(values + i)), _mm_loadu_si128((const __m128i*)(values + i + 4)));
+				__m128i hi16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(values + i + 8)), _mm_loadu_si128((const __m128i*)(values + i + 12)));
+				_mm_storeu_si128((__m128i*)(p + i), format == IAT_UINT_8 ? _mm_packus_epi16(lo16, hi16) : _mm_packs_epi16(lo16, hi16));
+			}
+#endif
+			for (; i < count; i++)
+				p[i] = (ia_uint8_t)values[i];
+		}
+		break;
+		default: /* IAT_UINT_16, IAT_INT_16 */
+		{
+			ia_uint16_t* p = (ia_uint16_t*)dst;
+#ifdef __SSE2__
+			/* unsigned values are biased to signed 16-bit for the saturating pack */
+			const __m128i bias = _mm_set1_epi32(format == IAT_UINT_16 ? 0x8000 : 0);
+			const __m128i flip = _mm_set1_epi16(format == IAT_UINT_16 ? (short)0x8000 : 0);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_packs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(values + i)), bias),
+				                            _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(values + i + 4)), bias));
+				_mm_storeu_si128((__m128i*)(p + i), _mm_xor_si128(v, flip));
+			}
+#endif
+			for (; i < count; i++)
+				p[i] = (ia_uint16_t)values[i];
+		}
+	}
+}
+
+static void ia_pixels_scale_float(ia_float_t* buf, ia_uint32_t count, ia_float_t scale, ia_float_t offset)
+{
+	ia_uint32_t i = 0;
+#ifdef __SSE2__
+	const __m128 vscale = _mm_set1_ps(scale), voffset = _mm_set1_ps(offset);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(buf + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(buf + i), vscale), voffset));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		buf[i] = buf[i] * scale + offset;
+	}
+}
+
+static void ia_pixels_load_double(const void* src, ia_format_t format, ia_double_t* buf, ia_uint32_t count)
+{
+	ia_uint32_t i;
+	const ia_uint8_t* p = (const ia_uint8_t*)src;
+	switch (format)
+	{
+		case IAT_BOOL:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((p[i >> 3] >> (i & 7)) & 1);
+		break;
+		case IAT_UINT_8:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)p[i];
+		break;
+		case IAT_INT_8:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_int8_t*)src)[i];
+		break;
+		case IAT_UINT_16:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_uint16_t*)src)[i];
+		break;
+		case IAT_INT_16:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_int16_t*)src)[i];
+		break;
+		case IAT_UINT_24:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)(p[3*i] | (p[3*i + 1] << 8) | (p[3*i + 2] << 16));
+		break;
+		case IAT_INT_24:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)(((ia_int32_t)(p[3*i] | (p[3*i + 1] << 8) | (p[3*i + 2] << 16)) ^ 0x800000) - 0x800000);
+		break;
+		case IAT_UINT_32:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_uint32_t*)src)[i];
+		break;
+		case IAT_INT_32:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_int32_t*)src)[i];
+		break;
+		case IAT_FLOAT:
+			for (i = 0; i < count; i++) buf[i] = (ia_double_t)((const ia_float_t*)src)[i];
+		break;
+		default: /* IAT_DOUBLE */
+			memcpy(buf, src, count * sizeof(ia_double_t));
+	}
+}
+
+static void ia_pixels_save_double(const ia_double_t* buf, ia_format_t format, void* dst, ia_uint32_t count)
+{
+	ia_int32_t  lo;
+	ia_uint32_t hi, i;
+	ia_double_t dlo, dhi;
+	ia_uint8_t* p = (ia_uint8_t*)dst;
+
+	switch (format)
+	{
+		case IAT_FLOAT:
+			for (i = 0; i < count; i++) ((ia_float_t*)dst)[i] = (ia_float_t)buf[i];
+			return ;
+		case IAT_DOUBLE:
+			memcpy(dst, buf, count * sizeof(ia_double_t));
+			return ;
+		case IAT_BOOL:
+			memset(dst, 0, (count + 7) >> 3);
+		break;
+		default:
+		break;
+	}
+
+	ia_format_min_max(format, &lo, &hi);
+	dlo = (ia_double_t)lo;
+	dhi = (ia_double_t)hi;
+	for (i = 0; i < count; i++)
+	{
+		ia_double_t v = buf[i] > dlo ? buf[i] : dlo;
+		/* offset from the minimum fits in 32 bits for every format */
+		ia_uint32_t value = (ia_uint32_t)((v < dhi ? v : dhi) - dlo + 0.5) + (ia_uint32_t)lo;
+		switch (format)
+		{
+			case IAT_BOOL:
+				p[i >> 3] |= (ia_uint8_t)(value << (i & 7));
+			break;
+			case IAT_UINT_8: case IAT_INT_8:
+				p[i] = (ia_uint8_t)value;
+			break;
+			case IAT_UINT_16: case IAT_INT_16:
+				((ia_uint16_t*)dst)[i] = (ia_uint16_t)value;
+			break;
+			case IAT_UINT_24: case IAT_INT_24:
+				p[3*i + 0] = (ia_uint8_t)(value);
+				p[3*i + 1] = (ia_uint8_t)(value >> 8);
+				p[3*i + 2] = (ia_uint8_t)(value >> 16);
+			break;
+			default: /* IAT_UINT_32, IAT_INT_32 */
+				((ia_uint32_t*)dst)[i] = value;
+		}
+	}
+}
+
+void ia_pixels_convert(const void* src, ia_format_t src_format, void* dst, ia_format_t dst_format, ia_uint32_t count, ia_double_t scale, ia_double_t offset)
+{
+	ia_uint32_t i;
+	ia_uint32_t src_bits = ia_format_size(src_format);
+	ia_uint32_t dst_bits = ia_format_size(dst_format);
+	ia_bool_t identity = (scale == 1.0 && offset == 0.0);
+
+	if (identity && src_format == dst_format)
+	{
+		memcpy(dst, src, (count * src_bits + 7) >> 3);
+		if (dst_format == IAT_BOOL && (count & 7))
+		{
+			((ia_uint8_t*)dst)[count >> 3] &= (ia_uint8_t)((1 << (count & 7)) - 1);
+		}
+		return ;
+	}
+
+	/* the block size keeps IAT_BOOL blocks byte aligned */
+	if (ia_pixels_is_float_exact(src_format) && ia_pixels_is_float_exact(dst_format))
+	{
+		ia_float_t buf[IA_PIXELS_BLOCK];
+		for (i = 0; i < count; i += IA_PIXELS_BLOCK)
+		{
+			ia_uint32_t n = MIN(IA_PIXELS_BLOCK, count - i);
+			ia_pixels_load_float((const ia_uint8_t*)src + ((i * src_bits) >> 3), src_format, buf, n);
+			if (!identity)
+			{
+				ia_pixels_scale_float(buf, n, (ia_float_t)scale, (ia_float_t)offset);
+			}
+			ia_pixels_save_float(buf, dst_format, (ia_uint8_t*)dst + ((i * dst_bits) >> 3), n);
+		}
+	}
+	else
+	{
+		ia_double_t buf[IA_PIXELS_BLOCK];
+		for (i = 0; i < count; i += IA_PIXELS_BLOCK)
+		{
+			ia_uint32_t k, n = MIN(IA_PIXELS_BLOCK, count - i);
+			ia_pixels_load_double((const ia_uint8_t*)src + ((i * src_bits) >> 3), src_format, buf, n);
+			if (!identity)
+			{
+				for (k = 0; k < n; k++)
+					buf[k] = buf[k] * scale + offset;
+			}
+			ia_pixels_save_double(buf, dst_format, (ia_uint8_t*)dst + ((i * dst_bits) >> 3), n);
+		}
+	}
+}
+
+void* ia_pixels_normalize_lut(ia_format_t format, ia_int32_t min, ia_uint32_t max, ia_int32_t new_min, ia_uint32_t new_max)
+{
+	ia_uint32_t c, length = ia_format_size(format) == 8 ? 0x100 : 0x10000;
+	void* lut = malloc(length * (ia_format_size(format) >> 3));
+	if (!lut)
+	{
+		return NULL;
+	}
+
+	for (c = 0; c < length; c++)
+	{
+		/* the float formula used per pixel by normalize_colors */
+		ia_double_t v = floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min));
+		ia_uint32_t n = v < 0 ? (ia_uint32_t)(ia_int32_t)v : (ia_uint32_t)v;
+		if (length == 0x100)
+			((ia_uint8_t*)lut)[c] = (ia_uint8_t)n;
+		else
+			((ia_uint16_t*)lut)[c] = (ia_uint16_t)n;
+	}
+	return lut;
+}
+
+void ia_pixels_lut_8(ia_uint8_t* pixels, const ia_uint8_t* lut, ia_uint32_t count)
+{
+	ia_uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		ia_uint8_t a = lut[pixels[i]], b = lut[pixels[i + 1]], c = lut[pixels[i + 2]], d = lut[pixels[i + 3]];
+		pixels[i] = a; pixels[i + 1] = b; pixels[i + 2] = c; pixels[i + 3] = d;
+	}
+	for (; i < count; i++)
+	{
+		pixels[i] = lut[pixels[i]];
+	}
+}
+
+void ia_pixels_lut_16(ia_uint16_t* pixels, const ia_uint16_t* lut, ia_uint32_t count)
+{
+	ia_uint32_t i;
+	for (i = 0; i < count; i++)
+	{
+		pixels[i] = lut[pixels[i]];
+	}
+}
+
+/*
+ * q = floor((c - min) * (new_max - new_min) / (max - min)) where all
+ * differences fit in 32 bits and their product fits in 64 bits. The
+ * quotient is estimated with a precomputed double ratio and corrected
+ * by the exact 64-bit products, so no division is done per pixel.
+ */
+void ia_pixels_normalize_32(ia_uint32_t* pixels, ia_uint32_t count, ia_bool_t is_signed, ia_int32_t min, ia_uint32_t max, ia_int32_t new_min, ia_uint32_t new_max)
+{
+	ia_uint32_t i;
+	ia_uint32_t range     = max - (ia_uint32_t)min;
+	ia_uint32_t new_range = new_max - (ia_uint32_t)new_min;
+	ia_double_t ratio     = (ia_double_t)new_range / (ia_double_t)range;
+	ia_uint64_t d         = range, n = new_range;
+
+	for (i = 0; i < count; i++)
+	{
+		ia_uint32_t c = pixels[i];
+		ia_uint64_t x, q, r;
+		if (is_signed)
+		{
+			if ((ia_int32_t)c < min) c = (ia_uint32_t)min;
+			if ((ia_int32_t)c > (ia_int32_t)max) c = max;
+		}
+		else
+		{
+			if (c < (ia_uint32_t)min) c = (ia_uint32_t)min;
+			if (c > max) c = max;
+		}
+		x = (ia_uint64_t)(c - (ia_uint32_t)min) * n;
+		q = (ia_uint64_t)((ia_double_t)(c - (ia_uint32_t)min) * ratio);
+		if (q > n) q = n;
+		/* at most a step or two away from the exact quotient */
+		while (q * d > x) q--;
+		r = x - q * d;
+		while (r >= d) { q++; r -= d; }
+		pixels[i] = (ia_uint32_t)new_min + (ia_uint32_t)q;
+	}
+}
@@ -0,0 +1,191 @@
+/*********************************************************************/
+/*                                                                   */
+/* Copyright (C) 2005, Alexander Marinov, Nadezhda Zlateva           */
+/*                                                                   */
+/* Project:       ia                                                 */
+/* Filename:      ia_planes.c                                        */
+/* Description:   Planar RGB image module                            */
+/*                                                                   */
+/*********************************************************************/
+
+#include <stdio.h>
+#include <malloc.h>
+#include <string.h>
+#include <ia/ia_planes.h>
+#include <ia/ia_pixels.h>
+
+/*********************************************************************/
+/*                        Implementation                             */
+/*********************************************************************/
+
+static ia_image_p ia_planes_plane(struct _ia_planes_t* self, ia_color_element_t color_element)
+{
+	switch (color_element)
+	{
+		case IA_COLOR_ELEMENT_RED:   return self->red;
+		case IA_COLOR_ELEMENT_GREEN: return self->green;
+		case IA_COLOR_ELEMENT_BLUE:  return self->blue;
+		default:
+			ASSERT(0), "planes:plane(%d) -> Not supported color element!\n", color_element);
+	}
+	return NULL;
+}
+
+static void ia_planes_from_image_(struct _ia_planes_t* self, ia_image_p image)
+{
+	ia_int32_t i;
+	if (image->is_gray || image->width != self->width || image->height != self->height)
+	{
+		ASSERT(0), "planes:from_image -> Expected %dx%d RGB image!\n", self->width, self->height);
+		return ;
+	}
+
+	switch (ia_format_size(image->format))
+	{
+		case 32:
+#pragma omp parallel for schedule(static)
+			for (i=0; i<self->height; i++)
+			{
+				ia_pixels_rgb32_to_planes((const ia_uint32_t*)IA_IMAGE_ROW(image, i),
+					IA_IMAGE_ROW(self->red, i), IA_IMAGE_ROW(self->green, i), IA_IMAGE_ROW(self->blue, i), self->width);
+			}
+		break;
+		case 24:
+#pragma omp parallel for schedule(static)
+			for (i=0; i<self->height; i++)
+			{
+				ia_pixels_rgb24_to_planes(IA_IMAGE_ROW(image, i),
+					IA_IMAGE_ROW(self->red, i), IA_IMAGE_ROW(self->green, i), IA_IMAGE_ROW(self->blue, i), self->width);
+			}
+		break;
+		default:
+		{
+			ia_int32_t j;
+			for (i=0; i<self->height; i++)
+			for (j=0; j<self->width; j++)
+			{
+				ia_uint32_t color = image->get_pixel(image, j, i);
+				IA_IMAGE_ROW(self->red, i)[j]   = (ia_uint8_t)IA_RED(color);
+				IA_IMAGE_ROW(self->green, i)[j] = (ia_uint8_t)IA_GREEN(color);
+				IA_IMAGE_ROW(self->blue, i)[j]  = (ia_uint8_t)IA_BLUE(color);
+			}
+		}
+	}
+}
+
+static ia_image_p ia_planes_to_image(struct _ia_planes_t* self, ia_format_t format)
+{
+	ia_int32_t i;
+	ia_image_p image;
+	if (ia_format_size(format) != 24 && ia_format_size(format) != 32)
+	{
+		ASSERT(0), "planes:to_image -> Not supported format %d!\n", format);
+		return NULL;
+	}
+
+	image = ia_image_new(self->width, self->height, format, IA_IMAGE_RGB);
+	if (!image)
+	{
+		return NULL;
+	}
+
+	if (ia_format_size(format) == 32)
+	{
+#pragma omp parallel for schedule(static)
+		for (i=0; i<self->height; i++)
+		{
+			ia_pixels_planes_to_rgb32(IA_IMAGE_ROW(self->red, i), IA_IMAGE_ROW(self->green, i), IA_IMAGE_ROW(self->blue, i),
+				(ia_uint32_t*)IA_IMAGE_ROW(image, i), self->width);
+		}
+	}
+	else
+	{
+#pragma omp parallel for schedule(static)
+		for (i=0; i<self->height; i++)
+		{
+			ia_pixels_planes_to_rgb24(IA_IMAGE_ROW(self->red, i), IA_IMAGE_ROW(self->green, i), IA_IMAGE_ROW(self->blue, i),
+				IA_IMAGE_ROW(image, i), self->width);
+		}
+	}
+	return image;
+}
+
+static void ia_planes_inverse(struct _ia_planes_t* self)
+{
+	/* the three planes are one contiguous byte buffer */
+	ia_int32_t i;
+	ia_uint8_t* data = (ia_uint8_t*)self->pixels.data;
+#pragma omp parallel for schedule(static)
+	for (i=0; i<(ia_int32_t)self->pixels.size; i++)
+	{
+		data[i] ^= 0xFF;
+	}
+}
+
+static struct _ia_planes_t* ia_planes_copy(struct _ia_planes_t* self)
+{
+	ia_planes_p planes = ia_planes_new(self->width, self->height);
+	if (planes)
+	{
+		memcpy(planes->pixels.data, self->pixels.data, self->pixels.size);
+	}
+	return planes;
+}
+
+static void ia_planes_destroy(struct _ia_planes_t* self)
+{
+	self->red->destroy(self->red);
+	self->green->destroy(self->green);
+	self->blue->destroy(self->blue);
+	if ((self->is_user_data == IA_FALSE) && (self->pixels.data != NULL))
+	{
+		free(self->pixels.data);
+	}
+	free(self);
+}
+
+ia_planes_p ia_planes_from_data(ia_uint16_t width, ia_uint16_t height, void* data)
+{
+	ia_uint32_t plane_size        = (ia_uint32_t)width * height;
+	ia_planes_p planes            = (ia_planes_p)malloc(sizeof(ia_planes_t));
+	planes->width                 = width;
+	planes->height                = height;
+	planes->is_user_data          = IA_TRUE;
+	planes->pixels.data           = data;
+	planes->pixels.size           = 3 * plane_size;
+	planes->red                   = ia_image_from_data(width, height, IAT_UINT_8, IA_IMAGE_GRAY, (ia_uint8_t*)data, plane_size);
+	planes->green                 = ia_image_from_data(width, height, IAT_UINT_8, IA_IMAGE_GRAY, (ia_uint8_t*)data + plane_size, plane_size);
+	planes->blue                  = ia_image_from_data(width, height, IAT_UINT_8, IA_IMAGE_GRAY, (ia_uint8_t*)data + 2 * plane_size, plane_size);
+	planes->plane                 = ia_planes_plane;
+	planes->from_image            = ia_planes_from_image_;
+	planes->to_image              = ia_planes_to_image;
+	planes->inverse               = ia_planes_inverse;
+	planes->copy                  = ia_planes_copy;
+	planes->destroy               = ia_planes_destroy;
+
+	return planes;
+}
+
+ia_planes_p ia_planes_new(ia_uint16_t width, ia_uint16_t height)
+{
+	ia_planes_p planes;
+	void* data = calloc(3, (ia_uint32_t)width * height);
+	if (!data)
+	{
+		return NULL;
+	}
+
+	planes = ia_planes_from_data(width, height, data);
+	planes->is_user_data = IA_FALSE;
+	return planes;
+}
+
+ia_planes_p ia_planes_from_image(ia_image_p image)
+{
+	ia_planes_p planes = ia_planes_new(image->width, image->height);
+	if (planes)
+	{
+		planes->from_image(planes, image);
+	}
+	return planes;
+}
@@ -13,6 +13,7 @@
 #include <math.h>
 #include <string.h>
 #include <ia/ia_signal.h>
+#include <ia/ia_pixels.h>
 #include <ia/algo/ia_otsu.h>
 
 /*********************************************************************/
@@ -301,14 +302,40 @@ static void ia_signal_normalize_colors(struct _ia_signal_t* self, ia_int32_t min
 		self->get_min_max(self, &min, &max);
 	}
 
-	if (min != max)
+	if (min == max)
 	{
-		for (i=0; i<self->length; i++)
+		return ;
+	}
+
+	switch (self->format)
+	{
+		case IAT_UINT_8: case IAT_INT_8:
+		case IAT_UINT_16: case IAT_INT_16:
 		{
-			ia_uint32_t c = self->get_pixel(self, i);
-			c=(ia_uint32_t)floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min));
-			self->set_pixel(self, i, c);
+			void* lut = ia_pixels_normalize_lut(self->format, min, max, new_min, new_max);
+			if (!lut)
+			{
+				break;
+			}
+			if (ia_format_size(self->format) == 8)
+				ia_pixels_lut_8((ia_uint8_t*)self->pixels.data, (const ia_uint8_t*)lut, self->length);
+			else
+				ia_pixels_lut_16((ia_uint16_t*)self->pixels.data, (const ia_uint16_t*)lut, self->length);
+			free(lut);
 		}
+		return ;
+		case IAT_UINT_32: case IAT_INT_32:
+			ia_pixels_normalize_32((ia_uint32_t*)self->pixels.data, self->length, ia_format_signed(self->format), min, max, new_min, new_max);
+		return ;
+		default:
+		break;
+	}
+
+	for (i=0; i<self->length; i++)
+	{
+		ia_uint32_t c = self->get_pixel(self, i);
+		c=(ia_uint32_t)floor(new_min + (new_max-new_min)*(float)(c-min)/(float)(max-min));
+		self->set_pixel(self, i, c);
 	}
 }
 
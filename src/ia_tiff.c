@@ -11,6 +11,7 @@
 #ifdef HAVE_TIFFLIB
 
 #include <ia/ia_image.h>
+#include <ia/ia_pixels.h>
 #include <tiffio.h>
 #include <string.h>
 #include <malloc.h>
@@ -96,7 +97,15 @@ ia_image_p ia_image_load_tiff(const ia_string_t src)
 			return NULL;
 		}
 		/*printf("reading line %d of %d from size %d to %d\n", row, h, TIFFScanlineSize(in), outlinesize);*/
-		memcpy(pbuf, inbuf, outlinesize);
+		if (samplesperpixel == 3 && bitspersample == 8)
+		{
+			/* unpack 24-bit RGB samples to IA_RGB colors */
+			ia_pixels_rgb24_to_rgb32((const ia_uint8_t*)inbuf, (ia_uint32_t*)pbuf, w);
+		}
+		else
+		{
+			memcpy(pbuf, inbuf, outlinesize);
+		}
 		pbuf += outlinesize;
 	}
 
@@ -112,6 +121,7 @@ void ia_image_save_tiff(ia_image_p image, const ia_string_t dst)
 	uint16 samplesperpixel = image->is_gray?1:3;
 	unsigned char *outbuf = (unsigned char *)image->pixels.data;
 	uint32 bufsize = image->width * bitspersample >> 3;
+	unsigned char *linebuf = NULL;
 	int row;
 
 	TIFF *out = TIFFOpen(dst, "w");
@@ -119,6 +129,14 @@ void ia_image_save_tiff(ia_image_p image, const ia_string_t dst)
 	{
 		return ;
 	}
+
+	if (!image->is_gray && bitspersample == 32)
+	{
+		/* IA_RGB colors are written as 8-bit RGB samples */
+		bitspersample = 8;
+		linebuf = (unsigned char *)malloc(image->width * 3);
+	}
+
 	TIFFSetField(out, TIFFTAG_IMAGEWIDTH, image->width);           /* set the width of the image */
 	TIFFSetField(out, TIFFTAG_IMAGELENGTH, image->height);         /* set the height of the image */
 	TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);   /* set number of channels per pixel */
@@ -131,12 +149,20 @@ void ia_image_save_tiff(ia_image_p image, const ia_string_t dst)
 	printf("writing bitspersample=%d, samplesperpixel=%d\n", bitspersample, samplesperpixel);
 	for (row=0; row < image->height; row++)
 	{
-		if (TIFFWriteScanline(out, outbuf, row, 0) < 0)
+		if (linebuf)
+		{
+			ia_pixels_rgb32_to_rgb24((const ia_uint32_t*)outbuf, linebuf, image->width);
+		}
+		if (TIFFWriteScanline(out, linebuf ? linebuf : outbuf, row, 0) < 0)
 			break;
 		outbuf += bufsize;
 	}
 
 	TIFFClose(out);
+	if (linebuf)
+	{
+		free(linebuf);
+	}
 }
 
 #endif /* HAVE_TIFFLIB */